@@ -0,0 +1,95 @@
+#include "CanvasItemPool.h"
+
+#ifdef GD_EXTENSION_GODOCTOPUS
+	#include <godot_cpp/classes/rendering_server.hpp>
+#else
+	#include "servers/rendering_server.h"
+#endif
+
+#include <algorithm>
+
+namespace godot {
+
+CanvasItemPool::~CanvasItemPool()
+{
+	clear();
+}
+
+RID CanvasItemPool::acquire(RID const &parent_p, RID const &material_p)
+{
+	RID rid_l;
+	if(!_idle.empty())
+	{
+		rid_l = _idle.back();
+		_idle.pop_back();
+	}
+	else
+	{
+		rid_l = create_canvas_item(parent_p, material_p);
+	}
+	++_used;
+	_high_water = std::max(_high_water, _used);
+	return rid_l;
+}
+
+void CanvasItemPool::acquire_many(RID const &parent_p, RID const &material_p, size_t count_p, std::vector<RID> &out_p)
+{
+	out_p.reserve(out_p.size() + count_p);
+	size_t idle_count_l = std::min(count_p, _idle.size());
+	out_p.insert(out_p.end(), _idle.end() - idle_count_l, _idle.end());
+	_idle.resize(_idle.size() - idle_count_l);
+	for(size_t i = idle_count_l ; i < count_p ; ++ i)
+	{
+		out_p.push_back(create_canvas_item(parent_p, material_p));
+	}
+	_used += count_p;
+	_high_water = std::max(_high_water, _used);
+}
+
+void CanvasItemPool::release(RID const &rid_p)
+{
+	_idle.push_back(rid_p);
+	--_used;
+}
+
+bool CanvasItemPool::reserve(RID const &parent_p, RID const &material_p, bool bounded_p, std::chrono::steady_clock::time_point const &deadline_p)
+{
+	while(_created < _reserved)
+	{
+		if(bounded_p && std::chrono::steady_clock::now() > deadline_p)
+		{
+			return false;
+		}
+		_idle.push_back(create_canvas_item(parent_p, material_p));
+	}
+	return true;
+}
+
+size_t CanvasItemPool::shrink(size_t watermark_p, size_t max_count_p)
+{
+	RenderingServer *rs_l = RenderingServer::get_singleton();
+	size_t count_l = 0;
+	while(_idle.size() > watermark_p && count_l < max_count_p)
+	{
+		rs_l->free_rid(_idle.back());
+		_idle.pop_back();
+		--_created;
+		++count_l;
+	}
+	// freed canvas items are not reserved anymore (they would be created again)
+	_reserved = std::min(_reserved, _created);
+	return count_l;
+}
+
+RID CanvasItemPool::create_canvas_item(RID const &parent_p, RID const &material_p)
+{
+	RenderingServer *rs_l = RenderingServer::get_singleton();
+	RID rid_l = rs_l->canvas_item_create();
+	rs_l->canvas_item_set_parent(rid_l, parent_p);
+	rs_l->canvas_item_set_default_texture_filter(rid_l, RenderingServer::CANVAS_ITEM_TEXTURE_FILTER_NEAREST);
+	rs_l->canvas_item_set_material(rid_l, material_p);
+	++_created;
+	return rid_l;
+}
+
+} // godot
@@ -0,0 +1,62 @@
+#pragma once
+
+#ifdef GD_EXTENSION_GODOCTOPUS
+	#include <godot_cpp/godot.hpp>
+#else
+	#include "core/templates/rid.h"
+#endif
+
+#include <chrono>
+#include <vector>
+
+namespace godot {
+
+/// @brief Owner of the canvas items of a rendering layer
+/// Canvas items of freed instances are kept idle to be reused by the next
+/// instances, idle canvas items above a watermark can be freed
+class CanvasItemPool
+{
+public:
+	~CanvasItemPool();
+
+	/// @brief take an idle canvas item (or create one)
+	/// the parent and material are only used when creating a canvas item
+	RID acquire(RID const &parent_p, RID const &material_p);
+	/// @brief take count_p canvas items in one pass : idle ones first, then the
+	/// missing ones are created, appended to out_p
+	void acquire_many(RID const &parent_p, RID const &material_p, size_t count_p, std::vector<RID> &out_p);
+	/// @brief give back a canvas item (must be cleared by the caller)
+	void release(RID const &rid_p);
+
+	/// @brief create idle canvas items until reserved ones exist
+	/// @return false if the deadline has been reached before
+	bool reserve(RID const &parent_p, RID const &material_p, bool bounded_p, std::chrono::steady_clock::time_point const &deadline_p);
+	void set_reserved(size_t reserved_p) { _reserved = reserved_p; }
+	bool is_reserve_pending() const { return _created < _reserved; }
+
+	/// @brief free idle canvas items above the watermark (at most max_count_p)
+	/// the reservation is lowered to the canvas items left
+	/// @return the number of canvas items freed
+	size_t shrink(size_t watermark_p, size_t max_count_p);
+	/// @brief free all idle canvas items
+	void clear() { shrink(0, _idle.size()); }
+
+	/// @brief canvas items owned (used and idle)
+	size_t get_created() const { return _created; }
+	size_t get_used() const { return _used; }
+	size_t get_idle() const { return _idle.size(); }
+	/// @brief maximum number of canvas items used at once
+	size_t get_high_water() const { return _high_water; }
+
+private:
+	RID create_canvas_item(RID const &parent_p, RID const &material_p);
+
+	std::vector<RID> _idle;
+	size_t _created = 0;
+	size_t _used = 0;
+	size_t _high_water = 0;
+	/// @brief number of canvas items to create ahead
+	size_t _reserved = 0;
+};
+
+} // godot
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace godot {
+
+/// @brief Lock free multiple producers single consumer queue
+/// Values are stored in a ring allocated once : pushing does not allocate (the
+/// value is moved in a preallocated cell). Producers reserve a cell with one
+/// compare exchange, the consumer pops without any synchronisation with other
+/// consumers (there must be only one at a time). When the ring is full values
+/// go to an overflow list under a mutex until the consumer takes it, producers
+/// never wait for the consumer. Values left in the queue are destroyed with it
+template<typename T>
+class CommandQueue
+{
+public:
+	/// @brief capacity_p is rounded up to a power of two
+	explicit CommandQueue(size_t capacity_p)
+	{
+		_capacity = 1;
+		while(_capacity < capacity_p)
+		{
+			_capacity <<= 1;
+		}
+		_mask = _capacity - 1;
+		_cells.reset(new Cell[_capacity]);
+		for(size_t i = 0 ; i < _capacity ; ++ i)
+		{
+			_cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	CommandQueue(CommandQueue const &) = delete;
+	CommandQueue & operator=(CommandQueue const &) = delete;
+
+	/// @brief push a value (thread safe, never blocks on the consumer)
+	/// when the ring is full the value is stored in an overflow list (allocates)
+	void push(T &&value_p)
+	{
+		if(!_overflowing.load(std::memory_order_acquire) && push_ring(value_p))
+		{
+			_size.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		// once a value overflowed the next ones follow it until the consumer takes them
+		std::lock_guard<std::mutex> lock_l(_overflow_mutex);
+		_overflow.push_back(std::move(value_p));
+		_overflowing.store(true, std::memory_order_release);
+		_size.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/// @brief pop a value (consumer thread only)
+	/// values of one producer are popped in the order they were pushed
+	/// @return false if the queue is empty
+	bool pop(T &value_p)
+	{
+		// overflowed values are older than anything pushed in the ring since they were taken
+		if(_taken_idx < _taken.size())
+		{
+			value_p = std::move(_taken[_taken_idx++]);
+			_size.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+		_taken.clear();
+		_taken_idx = 0;
+		// values pushed in the ring before overflowing come first :
+		// wait for the pushes in progress to empty the ring
+		while(!pop_ring(value_p))
+		{
+			if(_dequeue == _enqueue.load(std::memory_order_acquire))
+			{
+				return pop_overflow(value_p);
+			}
+			std::this_thread::yield();
+		}
+		_size.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	/// @brief approximate number of values in the queue
+	size_t size() const { return _size.load(std::memory_order_relaxed); }
+	size_t capacity() const { return _capacity; }
+
+private:
+	/// @return false if the ring is full (the value is left untouched)
+	bool push_ring(T &value_p)
+	{
+		size_t pos_l = _enqueue.load(std::memory_order_relaxed);
+		Cell *cell_l = nullptr;
+		while(true)
+		{
+			cell_l = &_cells[pos_l & _mask];
+			size_t sequence_l = cell_l->sequence.load(std::memory_order_acquire);
+			intptr_t diff_l = intptr_t(sequence_l) - intptr_t(pos_l);
+			if(diff_l == 0)
+			{
+				if(_enqueue.compare_exchange_weak(pos_l, pos_l + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if(diff_l < 0)
+			{
+				// cell not popped yet since the last lap
+				return false;
+			}
+			else
+			{
+				pos_l = _enqueue.load(std::memory_order_relaxed);
+			}
+		}
+		cell_l->value = std::move(value_p);
+		cell_l->sequence.store(pos_l + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// @return false if the next cell is not pushed (empty or push in progress)
+	bool pop_ring(T &value_p)
+	{
+		Cell &cell_l = _cells[_dequeue & _mask];
+		size_t sequence_l = cell_l.sequence.load(std::memory_order_acquire);
+		if(sequence_l != _dequeue + 1)
+		{
+			return false;
+		}
+		value_p = std::move(cell_l.value);
+		// release payloads now rather than when the cell is reused
+		cell_l.value = T();
+		cell_l.sequence.store(_dequeue + _capacity, std::memory_order_release);
+		++_dequeue;
+		return true;
+	}
+
+	/// @brief take the overflowed values (the ring is empty)
+	bool pop_overflow(T &value_p)
+	{
+		if(!_overflowing.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		{
+			std::lock_guard<std::mutex> lock_l(_overflow_mutex);
+			std::swap(_taken, _overflow);
+			// producers go back to the ring : their next values are popped after the taken ones
+			_overflowing.store(false, std::memory_order_release);
+		}
+		if(_taken.empty())
+		{
+			return false;
+		}
+		value_p = std::move(_taken[_taken_idx++]);
+		_size.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	struct Cell
+	{
+		/// @brief position the cell is ready for : pos to be pushed, pos + 1 to be popped
+		std::atomic<size_t> sequence {0};
+		T value;
+	};
+
+	std::unique_ptr<Cell[]> _cells;
+	size_t _capacity = 0;
+	size_t _mask = 0;
+	/// @brief next position to push (producers)
+	std::atomic<size_t> _enqueue {0};
+	/// @brief next position to pop (consumer)
+	size_t _dequeue = 0;
+
+	/// @brief values pushed while the ring was full (producers)
+	std::vector<T> _overflow;
+	std::mutex _overflow_mutex;
+	std::atomic<bool> _overflowing {false};
+	/// @brief overflowed values being popped (consumer)
+	std::vector<T> _taken;
+	size_t _taken_idx = 0;
+	std::atomic<size_t> _size {0};
+};
+
+} // godot
@@ -2,13 +2,21 @@
 #include "EntityDrawer.h"
 
 #include <algorithm>
+#include <cmath>
+#include <functional>
 #include "TextureCatcher.h"
 
 
 #ifdef GD_EXTENSION_GODOCTOPUS
 	#include <godot_cpp/variant/utility_functions.hpp>
+	#include <godot_cpp/classes/engine.hpp>
+	#include <godot_cpp/classes/rendering_device.hpp>
 	#include <godot_cpp/classes/rendering_server.hpp>
+	#include <godot_cpp/classes/worker_thread_pool.hpp>
 #else
+	#include "core/config/engine.h"
+	#include "core/object/worker_thread_pool.h"
+	#include "servers/rendering/rendering_device.h"
 	#include "servers/rendering_server.h"
 #endif
 
@@ -16,44 +24,19 @@
 
 namespace godot
 {
-	Vector3 color_from_idx(int idx_p)
+	Color color_from_idx(int idx_p)
 	{
 		// Compute the color based on the idx
 		int r = idx_p % 256;
 		int g = (idx_p/ 256 ) % 256;
 		int b = (idx_p/ (256*256) ) % 256;
-		return Vector3(r/255.,g/255.,b/255.);
+		return Color(r/255.,g/255.,b/255.);
 	}
 
-	int idx_from_color(Color const &color_p)
-	{
-		int r = int(color_p.r * 255);
-		int g = int(color_p.g * 255);
-		int b = int(color_p.b * 255);
-		if(r != 255 || g != 255 || b != 255)
-		{
-			return r + g *256 + b *256*256;
-		}
-		return -1;
-	}
-
-	Color safe_color(int x, int y, Ref<Image> const &image_p)
-	{
-		if(x >= 0 && x < image_p->get_width()
-		&& y >= 0 && y < image_p->get_height())
-		{
-			return image_p->get_pixel(x, y);
-		}
-		return Color(1.f,1.f,1.f,1.f);
-	}
-
-	void init_animation(DirectionalAnimation &anim_p, StringName const &base_anim_p)
+	void init_animation(DirectionalAnimation &anim_p, StringName const &base_anim_p, BakedFramesTable const &table_p, int frames_id_p)
 	{
 		anim_p.base_name = base_anim_p;
-		anim_p.names[DirectionHandler::UP] = "up_"+base_anim_p;
-		anim_p.names[DirectionHandler::DOWN] = "down_"+base_anim_p;
-		anim_p.names[DirectionHandler::LEFT] = "left_"+base_anim_p;
-		anim_p.names[DirectionHandler::RIGHT] = "right_"+base_anim_p;
+		anim_p.ids = table_p.get_directional_ids(frames_id_p, base_anim_p);
 	}
 
 	int get_direction(Vector2 const &dir_p, bool has_up_down_p)
@@ -87,41 +70,99 @@ namespace godot
 		return type_l;
 	}
 
+	/// @brief advance the frames of an animation that has not been updated for a while
+	/// if the animation does not loop stops at the end of the animation
+	void catch_up_animation(AnimationInstance &animation_p, BakedFramesTable const &table_p, BakedAnimation const &baked_p,
+		double elapsed_all_time_p, bool loop_p)
+	{
+		// frames without duration would loop forever
+		if(loop_p && baked_p.duration <= 0.)
+		{
+			return;
+		}
+		double elapsed_l = elapsed_all_time_p - animation_p.start;
+		if(loop_p)
+		{
+			elapsed_l = std::fmod(elapsed_l, baked_p.duration);
+		}
+		while(animation_p.frame_idx < baked_p.frame_count)
+		{
+			double duration_l = table_p.get_frame(baked_p, animation_p.frame_idx).duration;
+			if(elapsed_l < duration_l)
+			{
+				break;
+			}
+			elapsed_l -= duration_l;
+			++animation_p.frame_idx;
+			if(loop_p && animation_p.frame_idx >= baked_p.frame_count)
+			{
+				animation_p.frame_idx = 0;
+			}
+		}
+		animation_p.start = elapsed_all_time_p - elapsed_l;
+	}
+
 	EntityDrawer::~EntityDrawer()
 	{
+		// commands still queued are dropped (their payloads are released here) : the instances
+		// are freed directly below, not through the command queue which is never drained again
+		EntityCommand command_l;
+		while(_commands.pop(command_l)) {}
+		// free directly to release all canvas items
 		_instances.for_each([&](EntityInstance &, size_t idx_p) {
-			free_instance(idx_p);
+			if(_instances.is_valid(idx_p))
+			{
+				free_instance_internal(int(idx_p), false);
+			}
 		});
+		clear_released_rids();
+		_pool.clear();
+		_pickable_pool.clear();
 		delete _payload_handler;
+		_batches.clear();
+		if(_batch_mesh.is_valid())
+		{
+			RenderingServer::get_singleton()->free_rid(_batch_mesh);
+		}
 	}
 
 	// helper for animation
-	void set_up_animation(smart_list_handle<AnimationInstance> &handle_p,
-		double elapsed_time_p, Ref<Shader> const &shader_p, RID const &parent_p,
-		Vector2 const &offset_p, Ref<SpriteFrames> const & animation_p,
-		StringName const &current_animation_p, StringName const &next_animation_p, bool one_shot_p)
+	/// @param rid_p canvas item of the animation (invalid in batched mode)
+	void set_up_animation(smart_list_handle<AnimationInstance> &handle_p, RID const &rid_p, BakedFramesTable const &table_p,
+		double elapsed_time_p, Vector2 const &offset_p, int frames_id_p,
+		StringName const &current_animation_p, StringName const &next_animation_p, bool one_shot_p,
+		int z_index_p)
 	{
 		AnimationInstance &animation_l = handle_p.get();
 		animation_l.offset = offset_p;
-		animation_l.animation = animation_p;
+		animation_l.frames_id = frames_id_p;
 		animation_l.start = elapsed_time_p;
 		animation_l.frame_idx = 0;
 		animation_l.current_animation = current_animation_p;
+		animation_l.current_id = table_p.get_animation_id(frames_id_p, current_animation_p);
 		animation_l.next_animation = next_animation_p;
 		animation_l.one_shot = one_shot_p;
-
-		// if fresh new animation we set it up
-		if(handle_p.revision() == 0)
+		animation_l.z_index = z_index_p;
+		animation_l.drawn = false;
+		animation_l.timer_stamp = 0;
+		animation_l.freeing = false;
+
+		// batched instances are rendered through the batch multimesh
+		animation_l.info.rid = rid_p;
+		if(rid_p.is_valid())
 		{
-			// set up resources
-			animation_l.info.rid = RenderingServer::get_singleton()->canvas_item_create();
-			animation_l.info.material = Ref<ShaderMaterial>(memnew(ShaderMaterial));
-			animation_l.info.material->set_shader(shader_p);
+			// reset z_index in case we reuse an instance for a sub instance
+			RenderingServer::get_singleton()->canvas_item_set_z_index(rid_p, z_index_p);
+		}
+	}
 
-			RenderingServer::get_singleton()->canvas_item_set_parent(animation_l.info.rid, parent_p);
-			RenderingServer::get_singleton()->canvas_item_set_default_texture_filter(animation_l.info.rid, RenderingServer::CANVAS_ITEM_TEXTURE_FILTER_NEAREST);
-			RenderingServer::get_singleton()->canvas_item_set_material(animation_l.info.rid, animation_l.info.material->get_rid());
+	RID EntityDrawer::acquire_canvas_item()
+	{
+		if(_batched)
+		{
+			return RID();
 		}
+		return _pool.acquire(get_canvas_item(), get_material_rid());
 	}
 
 	int EntityDrawer::add_instance(Vector2 const &pos_p, Vector2 const &offset_p, Ref<SpriteFrames> const & animation_p,
@@ -129,34 +170,84 @@ namespace godot
 	{
 		std::lock_guard<std::mutex> lock_l(_internal_mutex);
 
+		int idx_l = add_instance_internal(pos_p, acquire_canvas_item(), offset_p, bake_frames(animation_p), current_animation_p, next_animation_p, one_shot_p, in_front_p);
+		// add payload
+		_payload_handler->add_payload();
+		return idx_l;
+	}
+
+	PackedInt32Array EntityDrawer::add_instances(PackedVector2Array const &positions_p, Vector2 const &offset_p, Ref<SpriteFrames> const & animation_p,
+		StringName const &current_animation_p, StringName const &next_animation_p, bool one_shot_p, bool in_front_p)
+	{
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+
+		int64_t count_l = positions_p.size();
+		PackedInt32Array indexes_l;
+		indexes_l.resize(count_l);
+
+		// reserve storage for the positions
+		_positions.reserve(_positions.size() + count_l);
+
+		// acquire all canvas items in one pass (idle ones first)
+		std::vector<RID> rids_l;
+		if(!_batched)
+		{
+			_pool.acquire_many(get_canvas_item(), get_material_rid(), size_t(count_l), rids_l);
+		}
+
+		int frames_id_l = bake_frames(animation_p);
+		Vector2 const *positions_l = positions_p.ptr();
+		int32_t *out_l = indexes_l.ptrw();
+		for(int64_t i = 0 ; i < count_l ; ++ i)
+		{
+			RID rid_l = _batched ? RID() : rids_l[i];
+			out_l[i] = add_instance_internal(positions_l[i], rid_l, offset_p, frames_id_l, current_animation_p, next_animation_p, one_shot_p, in_front_p);
+		}
+		// add payloads
+		_payload_handler->add_payloads(count_l);
+		return indexes_l;
+	}
+
+	int EntityDrawer::add_instance_internal(Vector2 const &pos_p, RID const &rid_p, Vector2 const &offset_p, int frames_id_p,
+		StringName const &current_animation_p, StringName const &next_animation_p, bool one_shot_p, bool in_front_p)
+	{
+		_mask_groups_dirty = true;
 		EntityInstance entity_l;
 
 		// animation
 		entity_l.animation = animations.recycle_instance();
-		set_up_animation(entity_l.animation, _elapsedAllTime, _shader, get_canvas_item(), offset_p, animation_p, current_animation_p, next_animation_p, one_shot_p);
-		// reset z_index in case we reuse an instance for a sub instance
-		RenderingServer::get_singleton()->canvas_item_set_z_index(entity_l.animation.get().info.rid, in_front_p? 1 : 0);
+		set_up_animation(entity_l.animation, rid_p, frames_table(), _elapsedAllTime, offset_p, frames_id_p, current_animation_p, next_animation_p, one_shot_p,
+			in_front_p? 1 : 0);
 
 		// register instance
 		smart_list_handle<EntityInstance> handle_l = _instances.new_instance(entity_l);
-		// add payload
-		_payload_handler->add_payload();
+		_to_schedule.push_back(int(handle_l.handle()));
 
 		// position
 		handle_l.get().pos_idx = pos_indexes.recycle_instance();
-		if(handle_l.get().pos_idx.get().idx < _newPos.size()
-		&& handle_l.get().pos_idx.get().idx < _oldPos.size())
+		PositionIndex &pos_idx_l = handle_l.get().pos_idx.get();
+		// recycled position indexes may point past the buffers after a compaction
+		// free slots past the buffers are all above the lowest one
+		if(!_free_positions.empty() && _free_positions.front() >= _positions.size())
 		{
-			_newPos[handle_l.get().pos_idx.get().idx] = pos_p;
-			_oldPos[handle_l.get().pos_idx.get().idx] = pos_p;
+			_free_positions.clear();
+			_stale_free_positions = 0;
+		}
+		if(_free_positions.empty())
+		{
+			pos_idx_l.idx = uint32_t(_positions.size());
 		}
 		else
 		{
-			// update index
-			handle_l.get().pos_idx.get().idx = _newPos.size();
-			_newPos.push_back(pos_p);
-			_oldPos.push_back(pos_p);
+			pos_idx_l.idx = pop_free_position();
+		}
+		pos_idx_l.birth_tick = _positions.spawn(pos_idx_l.idx, pos_p);
+		pos_idx_l.spawn = pos_p;
+		if(pos_idx_l.idx >= _pos_owners.size())
+		{
+			_pos_owners.resize(pos_idx_l.idx + 1, -1);
 		}
+		_pos_owners[pos_idx_l.idx] = int(handle_l.handle());
 
 		return int(handle_l.handle());
 	}
@@ -166,6 +257,7 @@ namespace godot
 					bool one_shot_p, bool in_front_p, bool use_directions_p)
 	{
 		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		_mask_groups_dirty = true;
 
 		if(!_instances.is_valid(idx_ref_p))
 		{
@@ -175,8 +267,8 @@ namespace godot
 
 		// animation
 		entity_l.animation = animations.recycle_instance();
-		set_up_animation(entity_l.animation, _elapsedAllTime, _shader, get_canvas_item(), offset_p, animation_p, current_animation_p, next_animation_p, one_shot_p);
-		RenderingServer::get_singleton()->canvas_item_set_z_index(entity_l.animation.get().info.rid, in_front_p ? 2 : -1);
+		set_up_animation(entity_l.animation, acquire_canvas_item(), frames_table(), _elapsedAllTime, offset_p, bake_frames(animation_p), current_animation_p, next_animation_p, one_shot_p,
+			in_front_p ? 2 : -1);
 
 		// copy reference for position and dir_handler
 		entity_l.pos_idx = _instances.get(idx_ref_p).pos_idx;
@@ -187,13 +279,15 @@ namespace godot
 			if(entity_l.dir_handler.is_valid())
 			{
 				DirectionalAnimation anim_l;
-				init_animation(anim_l, entity_l.animation.get().current_animation);
+				init_animation(anim_l, entity_l.animation.get().current_animation, frames_table(), entity_l.animation.get().frames_id);
 				entity_l.dir_animation = dir_animations.new_instance(anim_l);
+				entity_l.components |= uint8_t(COMPONENT_DIRECTIONAL);
 			}
 		}
 
 		// register instance
 		smart_list_handle<EntityInstance> handle_l = _instances.new_instance(entity_l);
+		_to_schedule.push_back(int(handle_l.handle()));
 		// add payload
 		_payload_handler->add_payload();
 
@@ -205,18 +299,78 @@ namespace godot
 
 	void EntityDrawer::free_instance(int idx_p, bool skip_main_free_p)
 	{
+		if(_command_queue && !skip_main_free_p)
+		{
+			push_command(EntityCommand(EntityCommand::FREE_INSTANCE, idx_p));
+			return;
+		}
 		std::lock_guard<std::mutex> *lock_l = nullptr;
 		if(!skip_main_free_p)
 		{
 			lock_l = new std::lock_guard<std::mutex>(_internal_mutex);
 		};
 
+		free_instance_internal(idx_p, skip_main_free_p);
+		if(!skip_main_free_p)
+		{
+			clear_released_rids();
+		}
+
+		delete lock_l;
+	}
+
+	void EntityDrawer::free_instances(PackedInt32Array const &indexes_p)
+	{
+		if(_command_queue)
+		{
+			EntityCommand command_l(EntityCommand::FREE_INSTANCES, -1);
+			command_l.indexes = indexes_p;
+			push_command(std::move(command_l));
+			return;
+		}
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		free_instances_internal(indexes_p);
+	}
+
+	void EntityDrawer::free_instances_internal(PackedInt32Array const &indexes_p)
+	{
+		int32_t const *indexes_l = indexes_p.ptr();
+		for(int64_t i = 0 ; i < indexes_p.size() ; ++ i)
+		{
+			// may have been freed as a sub instance of a previous index
+			if(_instances.is_valid(indexes_l[i]))
+			{
+				free_instance_internal(indexes_l[i], false);
+			}
+		}
+		clear_released_rids();
+	}
+
+	void EntityDrawer::free_instance_internal(int idx_p, bool skip_main_free_p)
+	{
+		_mask_groups_dirty = true;
 		EntityInstance &instance_l = _instances.get(idx_p);
 		// free all components that cannot be inherited
 		if(instance_l.animation.is_valid())
 		{
-			if(instance_l.animation.get().info.rid.is_valid())
-				RenderingServer::get_singleton()->canvas_item_clear(instance_l.animation.get().info.rid);
+			RenderingInfo &info_l = instance_l.animation.get().info;
+			auto material_it_l = _instance_materials.find(idx_p);
+			if(material_it_l != _instance_materials.end())
+			{
+				// pooled canvas items go back to the shared material
+				if(info_l.rid.is_valid())
+				{
+					RenderingServer::get_singleton()->canvas_item_set_material(info_l.rid, get_material_rid());
+				}
+				_instance_materials.erase(material_it_l);
+			}
+			if(info_l.rid.is_valid())
+			{
+				_released_rids.push_back(info_l.rid);
+				_pool.release(info_l.rid);
+				info_l.rid = RID();
+			}
+			release_batch_slot(instance_l.animation.get());
 			animations.free_instance(instance_l.animation);
 		}
 		if(instance_l.dir_animation.is_valid())
@@ -229,16 +383,21 @@ namespace godot
 		}
 		if(instance_l.alt_info.is_valid())
 		{
-			if(instance_l.alt_info.get().rid.is_valid())
-				RenderingServer::get_singleton()->canvas_item_clear(instance_l.alt_info.get().rid);
+			RenderingInfo &info_l = instance_l.alt_info.get();
+			if(info_l.rid.is_valid())
+			{
+				_released_rids.push_back(info_l.rid);
+				_pickable_pool.release(info_l.rid);
+				info_l.rid = RID();
+			}
 			alt_infos.free_instance(instance_l.alt_info);
 		}
 
-		for(smart_list_handle<EntityInstance> subs_l : instance_l.sub_instances)
+		for(smart_list_handle<EntityInstance> const &sub_l : instance_l.sub_instances)
 		{
-			if(subs_l.is_valid())
+			if(sub_l.is_valid())
 			{
-				free_instance(subs_l.handle(), true);
+				free_instance_internal(int(sub_l.handle()), true);
 			}
 		}
 
@@ -247,11 +406,12 @@ namespace godot
 		{
 			if(!skip_main_free_p)
 			{
-				std::list<smart_list_handle<EntityInstance> > & sub_instances_l = instance_l.main_instance.get().sub_instances;
+				SmallVector<smart_list_handle<EntityInstance>, 2> & sub_instances_l = instance_l.main_instance.get().sub_instances;
+				smart_list_handle<EntityInstance> self_l = _instances.get_handle(idx_p);
 				// remove itself
 				for(auto it_l = sub_instances_l.begin() ; it_l != sub_instances_l.end() ; ++it_l )
 				{
-					if(it_l->handle() == idx_p)
+					if(it_l->handle() == self_l.handle() && it_l->revision() == self_l.revision())
 					{
 						sub_instances_l.erase(it_l);
 						break;
@@ -262,6 +422,10 @@ namespace godot
 		// else we can clear the direction handler
 		else
 		{
+			uint32_t pos_idx_l = instance_l.pos_idx.get().idx;
+			_positions.kill(pos_idx_l);
+			_pos_owners[pos_idx_l] = -1;
+			push_free_position(pos_idx_l);
 			pos_indexes.free_instance(instance_l.pos_idx);
 			if(instance_l.dir_handler.is_valid())
 			{
@@ -272,24 +436,49 @@ namespace godot
 		// free payload
 		_payload_handler->free_payload(idx_p);
 		_instances.free_instance(idx_p);
-
-		delete lock_l;
 	}
 
 	void EntityDrawer::update_sprite_frames(int idx_p, Vector2 const &offset_p, Ref<SpriteFrames> const & animation_p)
 	{
+		if(_command_queue)
+		{
+			EntityCommand command_l(EntityCommand::UPDATE_SPRITE_FRAMES, idx_p);
+			command_l.vector = offset_p;
+			command_l.frames = animation_p;
+			push_command(std::move(command_l));
+			return;
+		}
 		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		update_sprite_frames_internal(idx_p, offset_p, animation_p);
+	}
 
+	void EntityDrawer::update_sprite_frames_internal(int idx_p, Vector2 const &offset_p, Ref<SpriteFrames> const & animation_p)
+	{
 		EntityInstance &entity_l = _instances.get(idx_p);
 		AnimationInstance &animation_l = entity_l.animation.get();
 		animation_l.offset = offset_p;
-		animation_l.animation = animation_p;
+		animation_l.frames_id = bake_frames(animation_p);
+		animation_l.drawn = false;
+		resolve_animation_ids(entity_l);
+		_to_schedule.push_back(idx_p);
 	}
 
 	void EntityDrawer::set_direction(int idx_p, Vector2 const &direction_p, bool just_looking_p)
 	{
+		if(_command_queue)
+		{
+			EntityCommand command_l(EntityCommand::SET_DIRECTION, idx_p);
+			command_l.vector = direction_p;
+			command_l.flag = just_looking_p;
+			push_command(std::move(command_l));
+			return;
+		}
 		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		set_direction_internal(idx_p, direction_p, just_looking_p);
+	}
 
+	void EntityDrawer::set_direction_internal(int idx_p, Vector2 const &direction_p, bool just_looking_p)
+	{
 		EntityInstance &instance_l = _instances.get(idx_p);
 		if(!instance_l.dir_handler.is_valid())
 		{
@@ -314,8 +503,19 @@ namespace godot
 
 	void EntityDrawer::add_direction_handler(int idx_p, bool has_up_down_p)
 	{
+		if(_command_queue)
+		{
+			EntityCommand command_l(EntityCommand::ADD_DIRECTION_HANDLER, idx_p);
+			command_l.flag = has_up_down_p;
+			push_command(std::move(command_l));
+			return;
+		}
 		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		add_direction_handler_internal(idx_p, has_up_down_p);
+	}
 
+	void EntityDrawer::add_direction_handler_internal(int idx_p, bool has_up_down_p)
+	{
 		EntityInstance &instance_l = _instances.get(idx_p);
 		if(instance_l.dir_handler.is_valid()
 		|| !instance_l.animation.is_valid())
@@ -329,15 +529,36 @@ namespace godot
 		instance_l.dir_handler = dir_handlers.new_instance(handler_l);
 
 		DirectionalAnimation anim_l;
-		init_animation(anim_l, instance_l.animation.get().current_animation);
+		init_animation(anim_l, instance_l.animation.get().current_animation, frames_table(), instance_l.animation.get().frames_id);
 		instance_l.dir_animation = dir_animations.new_instance(anim_l);
+		set_component(instance_l, COMPONENT_DIRECTIONAL, true);
+		_to_schedule.push_back(idx_p);
 	}
 
 	void EntityDrawer::remove_direction_handler(int idx_p)
 	{
+		if(_command_queue)
+		{
+			EntityCommand command_l(EntityCommand::REMOVE_DIRECTION_HANDLER, idx_p);
+			push_command(std::move(command_l));
+			return;
+		}
 		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		remove_direction_handler_internal(idx_p);
+	}
 
+	void EntityDrawer::remove_direction_handler_internal(int idx_p)
+	{
 		EntityInstance &instance_l = _instances.get(idx_p);
+		set_component(instance_l, COMPONENT_DIRECTIONAL, false);
+		// sub instances using the directions share the handler
+		for(smart_list_handle<EntityInstance> const &sub_l : instance_l.sub_instances)
+		{
+			if(sub_l.is_valid())
+			{
+				set_component(sub_l.get(), COMPONENT_DIRECTIONAL, false);
+			}
+		}
 		if(instance_l.dir_handler.is_valid())
 		{
 			dir_handlers.free_instance(instance_l.dir_handler);
@@ -350,86 +571,230 @@ namespace godot
 
 	void EntityDrawer::add_dynamic_animation(int idx_p, StringName const &idle_animation_p, StringName const &moving_animation_p)
 	{
+		if(_command_queue)
+		{
+			EntityCommand command_l(EntityCommand::ADD_DYNAMIC_ANIMATION, idx_p);
+			command_l.animation = idle_animation_p;
+			command_l.next_animation = moving_animation_p;
+			push_command(std::move(command_l));
+			return;
+		}
 		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		add_dynamic_animation_internal(idx_p, idle_animation_p, moving_animation_p);
+	}
 
+	void EntityDrawer::add_dynamic_animation_internal(int idx_p, StringName const &idle_animation_p, StringName const &moving_animation_p)
+	{
 		EntityInstance &instance_l = _instances.get(idx_p);
 		if(instance_l.dyn_animation.is_valid())
 		{
 			return;
 		}
 		DynamicAnimation dyn_l;
-		init_animation(dyn_l.idle, idle_animation_p);
-		init_animation(dyn_l.moving, moving_animation_p);
+		int frames_id_l = instance_l.animation.is_valid() ? instance_l.animation.get().frames_id : -1;
+		init_animation(dyn_l.idle, idle_animation_p, frames_table(), frames_id_l);
+		init_animation(dyn_l.moving, moving_animation_p, frames_table(), frames_id_l);
 		instance_l.dyn_animation = dyn_animations.new_instance(dyn_l);
+		set_component(instance_l, COMPONENT_DYNAMIC, true);
+		_to_schedule.push_back(idx_p);
 	}
 
 	void EntityDrawer::add_pickable(int idx_p)
 	{
+		if(_command_queue)
+		{
+			EntityCommand command_l(EntityCommand::ADD_PICKABLE, idx_p);
+			push_command(std::move(command_l));
+			return;
+		}
 		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		add_pickable_internal(idx_p);
+	}
 
+	void EntityDrawer::add_pickable_internal(int idx_p)
+	{
 		EntityInstance &instance_l = _instances.get(idx_p);
 		if(instance_l.alt_info.is_valid())
 		{
 			return;
 		}
 		instance_l.alt_info = alt_infos.recycle_instance();
+		set_component(instance_l, COMPONENT_PICKABLE, true);
 		RenderingInfo &info_l = instance_l.alt_info.get();
 
-		// if fresh new animation we set it up
-		if(instance_l.alt_info.revision() == 0 && _texture_catcher)
+		// take a canvas item from the pool
+		info_l.rid = RID();
+		if(_texture_catcher)
 		{
-			// set up resources
-			info_l.rid = RenderingServer::get_singleton()->canvas_item_create();
-			info_l.material = Ref<ShaderMaterial>(memnew(ShaderMaterial));
-			info_l.material->set_shader(_alt_shader);
-
-			RenderingServer::get_singleton()->canvas_item_set_parent(info_l.rid, _texture_catcher->get_alt_viewport()->get_canvas_item());
-			RenderingServer::get_singleton()->canvas_item_set_default_texture_filter(info_l.rid, RenderingServer::CANVAS_ITEM_TEXTURE_FILTER_NEAREST);
-			RenderingServer::get_singleton()->canvas_item_set_material(info_l.rid, info_l.material->get_rid());
+			info_l.rid = _pickable_pool.acquire(_texture_catcher->get_alt_viewport()->get_canvas_item(), _alt_material->get_rid());
+		}
+		// force redraw to render the alternative layer
+		if(instance_l.animation.is_valid())
+		{
+			instance_l.animation.get().drawn = false;
 		}
-		info_l.material->set_shader_parameter("idx_color", color_from_idx(idx_p));
 	}
 
 	void EntityDrawer::remove_pickable(int idx_p)
 	{
+		if(_command_queue)
+		{
+			EntityCommand command_l(EntityCommand::REMOVE_PICKABLE, idx_p);
+			push_command(std::move(command_l));
+			return;
+		}
 		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		remove_pickable_internal(idx_p);
+	}
 
+	void EntityDrawer::remove_pickable_internal(int idx_p)
+	{
 		EntityInstance &instance_l = _instances.get(idx_p);
 		if(instance_l.alt_info.is_valid())
 		{
-			if(instance_l.alt_info.get().rid.is_valid())
-				RenderingServer::get_singleton()->canvas_item_clear(instance_l.alt_info.get().rid);
+			RenderingInfo &info_l = instance_l.alt_info.get();
+			if(info_l.rid.is_valid())
+			{
+				RenderingServer::get_singleton()->canvas_item_clear(info_l.rid);
+				_pickable_pool.release(info_l.rid);
+				info_l.rid = RID();
+			}
 			alt_infos.free_instance(instance_l.alt_info);
+			set_component(instance_l, COMPONENT_PICKABLE, false);
+			_picking_changed = true;
 		}
 	}
 
 	void EntityDrawer::set_animation(int idx_p, StringName const &current_animation_p, StringName const &next_animation_p)
 	{
+		if(_command_queue)
+		{
+			EntityCommand command_l(EntityCommand::SET_ANIMATION, idx_p);
+			command_l.animation = current_animation_p;
+			command_l.next_animation = next_animation_p;
+			push_command(std::move(command_l));
+			return;
+		}
 		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		set_animation_internal(idx_p, current_animation_p, next_animation_p);
+	}
 
+	void EntityDrawer::set_animation_internal(int idx_p, StringName const &current_animation_p, StringName const &next_animation_p)
+	{
 		EntityInstance &instance_l = _instances.get(idx_p);
 		if(!instance_l.animation.is_valid())
 		{
 			return;
 		}
+		restart_animation(instance_l, current_animation_p, next_animation_p);
+		_to_schedule.push_back(idx_p);
+	}
+
+	void EntityDrawer::restart_animation(EntityInstance &instance_p, StringName const &current_animation_p, StringName const &next_animation_p)
+	{
 		/// IMPORTANT this has to be done before next_animation = next_animation_p because
 		/// current_animation_p is a reference to old next_animation therefore updating it break
 		/// the value
-		if(instance_l.dir_animation.is_valid())
+		set_current_animation(instance_p, current_animation_p);
+		instance_p.animation.get().next_animation = next_animation_p;
+		instance_p.animation.get().frame_idx = 0;
+		instance_p.animation.get().start = _elapsedAllTime;
+		instance_p.animation.get().one_shot = false;
+	}
+
+	void EntityDrawer::set_current_animation(EntityInstance &instance_p, StringName const &animation_p)
+	{
+		AnimationInstance &animation_l = instance_p.animation.get();
+		BakedFramesTable const &table_l = frames_table();
+		if(instance_p.dir_animation.is_valid())
 		{
-			init_animation(instance_l.dir_animation.get(), current_animation_p);
+			init_animation(instance_p.dir_animation.get(), animation_p, table_l, animation_l.frames_id);
+		}
+		animation_l.current_animation = animation_p;
+		animation_l.current_id = table_l.get_animation_id(animation_l.frames_id, animation_p);
+	}
+
+	int EntityDrawer::bake_frames(Ref<SpriteFrames> const &frames_p)
+	{
+		if(frames_p.is_valid() && _watched_frames.insert(frames_p->get_instance_id()).second)
+		{
+			frames_p->connect("changed", Callable(this, "_on_sprite_frames_changed").bind(frames_p));
+		}
+		return frames_table().bake(frames_p);
+	}
+
+	void EntityDrawer::_on_sprite_frames_changed(Ref<SpriteFrames> const &frames_p)
+	{
+		// under the draw lock : no draw is reading the instances being moved
+		std::lock_guard<std::mutex> lock_l(_mutex);
+		std::lock_guard<std::mutex> lock_internal_l(_internal_mutex);
+		uint64_t changed_l = frames_p->get_instance_id();
+		int frames_id_l = frames_table().rebake(frames_p);
+		if(frames_id_l < 0)
+		{
+			return;
+		}
+		_instances.for_each([&](EntityInstance &instance_p, size_t idx_p) {
+			if(!instance_p.animation.is_valid())
+			{
+				return;
+			}
+			AnimationInstance &animation_l = instance_p.animation.get();
+			// baked again in place : only submit the new frames
+			if(animation_l.frames_id == frames_id_l)
+			{
+				animation_l.drawn = false;
+				return;
+			}
+			if(animation_l.frames_id < 0
+			|| frames_table().get_sprite_frames(animation_l.frames_id)->get_instance_id() != changed_l)
+			{
+				return;
+			}
+			// frames may have been removed : restart the animation
+			animation_l.frames_id = frames_id_l;
+			animation_l.frame_idx = 0;
+			animation_l.start = _elapsedAllTime;
+			animation_l.drawn = false;
+			resolve_animation_ids(instance_p);
+			_to_schedule.push_back(int(idx_p));
+		});
+	}
+
+	void EntityDrawer::resolve_animation_ids(EntityInstance &instance_p)
+	{
+		AnimationInstance &animation_l = instance_p.animation.get();
+		BakedFramesTable const &table_l = frames_table();
+		animation_l.current_id = table_l.get_animation_id(animation_l.frames_id, animation_l.current_animation);
+		if(instance_p.dir_animation.is_valid())
+		{
+			DirectionalAnimation &dir_l = instance_p.dir_animation.get();
+			init_animation(dir_l, StringName(dir_l.base_name), table_l, animation_l.frames_id);
+		}
+		if(instance_p.dyn_animation.is_valid())
+		{
+			DynamicAnimation &dyn_l = instance_p.dyn_animation.get();
+			init_animation(dyn_l.idle, StringName(dyn_l.idle.base_name), table_l, animation_l.frames_id);
+			init_animation(dyn_l.moving, StringName(dyn_l.moving.base_name), table_l, animation_l.frames_id);
 		}
-		instance_l.animation.get().current_animation = current_animation_p;
-		instance_l.animation.get().next_animation = next_animation_p;
-		instance_l.animation.get().frame_idx = 0;
-		instance_l.animation.get().start = _elapsedAllTime;
-		instance_l.animation.get().one_shot = false;
 	}
 
 	void EntityDrawer::set_proritary_animation(int idx_p, StringName const &current_animation_p, StringName const &next_animation_p)
 	{
+		if(_command_queue)
+		{
+			EntityCommand command_l(EntityCommand::SET_PRORITARY_ANIMATION, idx_p);
+			command_l.animation = current_animation_p;
+			command_l.next_animation = next_animation_p;
+			push_command(std::move(command_l));
+			return;
+		}
 		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		set_proritary_animation_internal(idx_p, current_animation_p, next_animation_p);
+	}
 
+	void EntityDrawer::set_proritary_animation_internal(int idx_p, StringName const &current_animation_p, StringName const &next_animation_p)
+	{
 		EntityInstance &instance_l = _instances.get(idx_p);
 		if(!instance_l.animation.is_valid())
 		{
@@ -438,37 +803,42 @@ namespace godot
 		/// IMPORTANT this has to be done before next_animation = next_animation_p because
 		/// current_animation_p is a reference to old next_animation therefore updating it break
 		/// the value
-		if(instance_l.dir_animation.is_valid())
-		{
-			init_animation(instance_l.dir_animation.get(), current_animation_p);
-		}
-		instance_l.animation.get().current_animation = current_animation_p;
+		set_current_animation(instance_l, current_animation_p);
 		instance_l.animation.get().next_animation = next_animation_p;
 		instance_l.animation.get().frame_idx = 0;
 		instance_l.animation.get().start = _elapsedAllTime;
 		instance_l.animation.get().one_shot = false;
 		instance_l.animation.get().has_priority = true;
+		_to_schedule.push_back(idx_p);
 	}
 
 	void EntityDrawer::set_animation_one_shot(int idx_p, StringName const &current_animation_p, bool priority_p)
 	{
+		if(_command_queue)
+		{
+			EntityCommand command_l(EntityCommand::SET_ANIMATION_ONE_SHOT, idx_p);
+			command_l.animation = current_animation_p;
+			command_l.flag = priority_p;
+			push_command(std::move(command_l));
+			return;
+		}
 		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		set_animation_one_shot_internal(idx_p, current_animation_p, priority_p);
+	}
 
+	void EntityDrawer::set_animation_one_shot_internal(int idx_p, StringName const &current_animation_p, bool priority_p)
+	{
 		EntityInstance &instance_l = _instances.get(idx_p);
 		if(!instance_l.animation.is_valid())
 		{
 			return;
 		}
-		instance_l.animation.get().current_animation = current_animation_p;
+		set_current_animation(instance_l, current_animation_p);
 		instance_l.animation.get().frame_idx = 0;
 		instance_l.animation.get().start = _elapsedAllTime;
 		instance_l.animation.get().one_shot = true;
 		instance_l.animation.get().has_priority = priority_p;
-
-		if(instance_l.dir_animation.is_valid())
-		{
-			init_animation(instance_l.dir_animation.get(), current_animation_p);
-		}
+		_to_schedule.push_back(idx_p);
 	}
 
 	StringName const & EntityDrawer::get_animation(int idx_p) const
@@ -486,341 +856,2054 @@ namespace godot
 
 	void EntityDrawer::set_new_pos(int idx_p, Vector2 const &pos_p)
 	{
-		size_t const &pos_idx_l = _instances.get(idx_p).pos_idx.get().idx;
-		_newPos[pos_idx_l] = pos_p;
+		if(_command_queue)
+		{
+			EntityCommand command_l(EntityCommand::SET_NEW_POS, idx_p);
+			command_l.vector = pos_p;
+			push_command(std::move(command_l));
+			return;
+		}
+		set_new_pos_internal(idx_p, pos_p);
 	}
 
-	Vector2 const & EntityDrawer::get_old_pos(int idx_p)
+	void EntityDrawer::set_new_pos_internal(int idx_p, Vector2 const &pos_p)
 	{
 		size_t const &pos_idx_l = _instances.get(idx_p).pos_idx.get().idx;
-		return _oldPos[pos_idx_l];
+		_positions.state().set(pos_idx_l, pos_p);
 	}
 
-	void EntityDrawer::update_pos()
+	Vector2 EntityDrawer::get_old_pos(int idx_p)
 	{
-		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		size_t const &pos_idx_l = _instances.get(idx_p).pos_idx.get().idx;
+		return _positions.published().get(pos_idx_l);
+	}
 
-		_elapsedTime = 0.;
-		// swap positions
-		std::swap(_oldPos, _newPos);
+	int EntityDrawer::get_pos_index(int idx_p) const
+	{
+		return int(_instances.get(idx_p).pos_idx.get().idx);
 	}
 
-	Ref<ShaderMaterial> EntityDrawer::get_shader_material(int idx_p)
+	void EntityDrawer::set_new_pos_batch(PackedInt32Array const &indexes_p, PackedVector2Array const &positions_p)
 	{
-		EntityInstance const &instance_l = _instances.get(idx_p);
-		if(!instance_l.animation.is_valid())
+		if(_command_queue)
 		{
-			return Ref<ShaderMaterial>();
+			EntityCommand command_l(EntityCommand::SET_NEW_POS_BATCH, -1);
+			command_l.indexes = indexes_p;
+			command_l.positions = positions_p;
+			push_command(std::move(command_l));
+			return;
 		}
-		return instance_l.animation.get().info.material;
+		set_new_pos_batch_internal(indexes_p, positions_p);
 	}
 
-	void EntityDrawer::set_shader_bool_param(int idx_p, String const &param_p, bool value_p)
+	void EntityDrawer::set_new_pos_batch_internal(PackedInt32Array const &indexes_p, PackedVector2Array const &positions_p)
 	{
-		EntityInstance &instance_l = _instances.get(idx_p);
-		if(instance_l.animation.is_valid()
-		&& instance_l.animation.get().info.material.is_valid())
+		int64_t size_l = std::min(indexes_p.size(), positions_p.size());
+		int32_t const *indexes_l = indexes_p.ptr();
+		Vector2 const *positions_l = positions_p.ptr();
+		for(int64_t i = 0 ; i < size_l ; ++ i)
 		{
-			instance_l.animation.get().info.material->set_shader_parameter(param_p, value_p);
+			size_t pos_idx_l = _instances.get(indexes_l[i]).pos_idx.get().idx;
+			_positions.state().set(pos_idx_l, positions_l[i]);
 		}
 	}
 
-	void EntityDrawer::set_shader_bool_params(String const &param_p, TypedArray<bool> const &values_p)
+	void EntityDrawer::set_new_pos_dense(PackedVector2Array const &positions_p)
 	{
-		_instances.for_each([&](EntityInstance & instance_l, size_t idx_p) {
-			if(instance_l.animation.is_valid()
-			&& instance_l.animation.get().info.material.is_valid())
-			{
-				instance_l.animation.get().info.material->set_shader_parameter(param_p, values_p[idx_p]);
-			}
-		});
+		if(_command_queue)
+		{
+			EntityCommand command_l(EntityCommand::SET_NEW_POS_DENSE, -1);
+			command_l.positions = positions_p;
+			push_command(std::move(command_l));
+			return;
+		}
+		set_new_pos_dense_internal(positions_p);
 	}
 
-	void EntityDrawer::set_shader_bool_params_from_indexes(String const &param_p, TypedArray<int> const &indexes_p, bool value_indexes_p)
+	void EntityDrawer::set_new_pos_dense_internal(PackedVector2Array const &positions_p)
 	{
-		// set for indexes
-		for(size_t i = 0 ; i < indexes_p.size() ; ++ i)
+		PositionBuffer &state_l = _positions.state();
+		size_t size_l = std::min<size_t>(positions_p.size(), state_l.size());
+		Vector2 const *positions_l = positions_p.ptr();
+		float *x_l = state_l.x.data();
+		float *y_l = state_l.y.data();
+		for(size_t i = 0 ; i < size_l ; ++ i)
 		{
-			int idx_l = indexes_p[i];
-			if(_instances.is_valid(idx_l)
-			&& _instances.get(idx_l).animation.is_valid()
-			&& _instances.get(idx_l).animation.get().info.material.is_valid())
-			{
-				_instances.get(idx_l).animation.get().info.material->set_shader_parameter(param_p, value_indexes_p);
-			}
+			x_l[i] = positions_l[i].x;
+			y_l[i] = positions_l[i].y;
 		}
 	}
 
-	void EntityDrawer::set_all_shader_bool_params_from_indexes(String const &param_p, TypedArray<int> const &indexes_p, bool value_indexes_p, bool value_others_p)
+	PackedVector2Array EntityDrawer::get_old_pos_batch(PackedInt32Array const &indexes_p) const
 	{
-		// set all default values
-		_instances.for_each([&](EntityInstance & instance_l, size_t ) {
-			if(instance_l.animation.is_valid()
-			&& instance_l.animation.get().info.material.is_valid())
-			{
-				instance_l.animation.get().info.material->set_shader_parameter(param_p, value_others_p);
-			}
-		});
+		PackedVector2Array positions_l;
+		positions_l.resize(indexes_p.size());
+		int32_t const *indexes_l = indexes_p.ptr();
+		Vector2 *out_l = positions_l.ptrw();
+		for(int64_t i = 0 ; i < indexes_p.size() ; ++ i)
+		{
+			out_l[i] = _positions.published().get(_instances.get(indexes_l[i]).pos_idx.get().idx);
+		}
+		return positions_l;
+	}
 
-		// set for indexes
-		for(size_t i = 0 ; i < indexes_p.size() ; ++ i)
+	PackedVector2Array EntityDrawer::get_old_pos_dense() const
+	{
+		PositionBuffer const &published_l = _positions.published();
+		PackedVector2Array positions_l;
+		positions_l.resize(published_l.size());
+		Vector2 *out_l = positions_l.ptrw();
+		for(size_t i = 0 ; i < published_l.size() ; ++ i)
 		{
-			int idx_l = indexes_p[i];
-			if(_instances.is_valid(idx_l)
-			&& _instances.get(idx_l).animation.is_valid()
-			&& _instances.get(idx_l).animation.get().info.material.is_valid())
-			{
-				_instances.get(idx_l).animation.get().info.material->set_shader_parameter(param_p, value_indexes_p);
-			}
+			out_l[i] = Vector2(published_l.x[i], published_l.y[i]);
 		}
+		return positions_l;
 	}
 
-	TypedArray<int> EntityDrawer::indexes_from_texture(Rect2 const &rect_p) const
+	void EntityDrawer::update_pos(double sim_time_p)
 	{
-		TypedArray<bool> all_added_l = index_array_from_texture(rect_p);
+		if(_command_queue)
+		{
+			EntityCommand command_l(EntityCommand::UPDATE_POS, -1);
+			command_l.time = sim_time_p;
+			push_command(std::move(command_l));
+			return;
+		}
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		update_pos_internal(sim_time_p);
+	}
 
-		TypedArray<int> indexes_l;
-		for(int idx_l = 0 ; idx_l < all_added_l.size() ; ++ idx_l)
+	void EntityDrawer::update_pos_internal(double sim_time_p)
+	{
+		// compact on the writer side, moved positions are published right away
+		if(_compaction)
 		{
-			if (all_added_l[idx_l])
+			_compacting = _compacting || position_fragmentation() > _compaction_threshold;
+			if(_compacting)
 			{
-				indexes_l.append(idx_l);
+				if(process_compaction(true) > 0)
+				{
+					_positions_compacted = true;
+				}
+				_compacting = _free_positions.size() > _stale_free_positions;
 			}
 		}
-
-		return indexes_l;
+		// publish positions, they will be acquired by the next process
+		_positions.publish(sim_time_p < 0. ? PositionSnapshots::now() : sim_time_p);
+	}
+
+	void EntityDrawer::acquire_positions()
+	{
+		if(!_positions.acquire())
+		{
+			return;
+		}
+		PositionSnapshot const &snapshot_l = _positions.front();
+		std::swap(_oldPos, _newPos);
+		// positions past the snapshot (spawned since or truncated by a compaction) are not drawn from the buffers
+		size_t size_l = snapshot_l.positions.size();
+		_newPos.resize(size_l);
+		_oldPos.resize(size_l);
+		std::copy(snapshot_l.positions.x.begin(), snapshot_l.positions.x.end(), _newPos.x.begin());
+		std::copy(snapshot_l.positions.y.begin(), snapshot_l.positions.y.end(), _newPos.y.begin());
+		// positions published for the first time have no valid old position
+		for(size_t i = 0 ; i < snapshot_l.births.size() ; ++ i)
+		{
+			if(snapshot_l.births[i] > _positions_tick)
+			{
+				_oldPos.x[i] = _newPos.x[i];
+				_oldPos.y[i] = _newPos.y[i];
+			}
+		}
+		if(_jitter_buffer_size > 0)
+		{
+			_history.push(snapshot_l, _positions_tick);
+		}
+		// follow the simulation clock : jump on the first snapshot or a big drift, else correct smoothly
+		double drift_l = snapshot_l.time - _sim_clock;
+		if(_positions_tick == 0 || std::abs(drift_l) > SIM_CLOCK_RESYNC)
+		{
+			_sim_clock = snapshot_l.time;
+		}
+		else
+		{
+			_sim_clock += drift_l * SIM_CLOCK_CORRECTION;
+		}
+		_positions_tick = snapshot_l.tick;
+		_elapsedTime = 0.;
+		update_grid();
+	}
+
+	void EntityDrawer::update_grid()
+	{
+		PositionSnapshot const &snapshot_l = _positions.front();
+		std::lock_guard<std::mutex> lock_l(_grid_mutex);
+		for(size_t i = 0 ; i < snapshot_l.births.size() ; ++ i)
+		{
+			if(snapshot_l.births[i] == 0)
+			{
+				_grid.remove(i);
+			}
+			else
+			{
+				_grid.update(i, snapshot_l.positions.get(i));
+			}
+		}
+		// positions truncated by a compaction
+		_grid.truncate(snapshot_l.births.size());
+	}
+
+	void EntityDrawer::set_jitter_buffer_size(int size_p)
+	{
+		std::lock_guard<std::mutex> lock_l(_mutex);
+
+		_jitter_buffer_size = std::max(0, size_p);
+		_history.set_capacity(_jitter_buffer_size);
+	}
+
+	Vector2 EntityDrawer::get_draw_pos(PositionIndex const &pos_idx_p) const
+	{
+		if(pos_idx_p.birth_tick > _positions_tick || pos_idx_p.idx >= _drawPos.size())
+		{
+			return pos_idx_p.spawn;
+		}
+		return _drawPos.get(pos_idx_p.idx);
+	}
+
+	void EntityDrawer::set_culling_cell_size(double cell_size_p)
+	{
+		ERR_FAIL_COND_MSG(cell_size_p <= 0., "culling cell size must be positive");
+		std::lock_guard<std::mutex> lock_l(_mutex);
+		{
+			std::lock_guard<std::mutex> lock_grid_l(_grid_mutex);
+			_grid.set_cell_size(cell_size_p);
+		}
+		update_grid();
+	}
+
+	void EntityDrawer::update_visible_positions()
+	{
+		_visible_positions.assign(_newPos.size(), !_culling);
+		if(!_culling || !get_viewport())
+		{
+			return;
+		}
+		// camera rect in local coordinates
+		Transform2D screen_to_local_l = get_global_transform_with_canvas().affine_inverse();
+		Rect2 screen_l = get_viewport()->get_visible_rect();
+		Vector2 corner_a_l = screen_to_local_l.xform(screen_l.get_position()) / _scale;
+		Vector2 corner_b_l = screen_to_local_l.xform(screen_l.get_end()) / _scale;
+		Rect2 rect_l = Rect2(corner_a_l, corner_b_l - corner_a_l).abs().grow(_culling_margin);
+
+		std::lock_guard<std::mutex> lock_l(_grid_mutex);
+		_grid.query(rect_l, [&](size_t idx_p) {
+			if(idx_p < _visible_positions.size())
+			{
+				_visible_positions[idx_p] = true;
+			}
+		});
+	}
+
+	void EntityDrawer::reserve(int count_p, int pickable_count_p)
+	{
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		// batched instances do not use canvas items
+		_pool.set_reserved(_batched ? 0 : size_t(std::max(count_p, 0)));
+		_pickable_pool.set_reserved(_picking_mode == PICKING_CPU ? 0 : size_t(std::max(pickable_count_p, 0)));
+		process_reservation(_reserve_time_budget > 0.);
+	}
+
+	bool EntityDrawer::process_reservation(bool bounded_p)
+	{
+		std::chrono::steady_clock::time_point deadline_l = std::chrono::steady_clock::now()
+			+ std::chrono::microseconds(int64_t(_reserve_time_budget * 1000.));
+
+		bool done_l = _pool.reserve(get_canvas_item(), get_material_rid(), bounded_p, deadline_l);
+		if(!_pickable_pool.is_reserve_pending())
+		{
+			return done_l;
+		}
+		// picking layer is created when ready
+		if(!_texture_catcher)
+		{
+			return false;
+		}
+		return done_l && _pickable_pool.reserve(_texture_catcher->get_alt_viewport()->get_canvas_item(), _alt_material->get_rid(), bounded_p, deadline_l);
+	}
+
+	void EntityDrawer::shrink_to_fit()
+	{
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		_pool.shrink(size_t(_pool_watermark), _pool.get_idle());
+		_pickable_pool.shrink(size_t(_pool_watermark), _pickable_pool.get_idle());
+		// the next process must not create the freed canvas items again
+		DEV_ASSERT(!_pool.is_reserve_pending() && !_pickable_pool.is_reserve_pending());
+	}
+
+	Dictionary EntityDrawer::get_memory_usage() const
+	{
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		Dictionary usage_l;
+		usage_l["instances"] = int64_t(_instances.size() * sizeof(EntityInstance));
+		usage_l["animations"] = int64_t(animations.size() * sizeof(AnimationInstance));
+		usage_l["dir_handlers"] = int64_t(dir_handlers.size() * sizeof(DirectionHandler));
+		usage_l["dir_animations"] = int64_t(dir_animations.size() * sizeof(DirectionalAnimation));
+		usage_l["dyn_animations"] = int64_t(dyn_animations.size() * sizeof(DynamicAnimation));
+		usage_l["alt_infos"] = int64_t(alt_infos.size() * sizeof(RenderingInfo));
+		usage_l["pos_indexes"] = int64_t(pos_indexes.size() * sizeof(PositionIndex));
+
+		// sub instance handles only allocate above their inline capacity
+		size_t sub_instances_l = 0;
+		for(size_t i = 0 ; i < _instances.size() ; ++ i)
+		{
+			if(_instances.is_valid(i))
+			{
+				sub_instances_l += _instances.get(i).sub_instances.heap_size();
+			}
+		}
+		usage_l["sub_instances"] = int64_t(sub_instances_l);
+
+		size_t positions_l = (_newPos.size() + _oldPos.size() + _drawPos.size()) * 2 * sizeof(float);
+		usage_l["positions"] = int64_t(positions_l);
+		usage_l["draw_commands"] = int64_t(_draw_commands.capacity() * sizeof(DrawCommand));
+		usage_l["command_queue"] = int64_t(_commands.capacity() * sizeof(EntityCommand));
+		usage_l["canvas_items"] = int64_t(_pool.get_created() + _pickable_pool.get_created());
+		return usage_l;
+	}
+
+	Dictionary EntityDrawer::get_fragmentation() const
+	{
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		Dictionary fragmentation_l;
+		fragmentation_l["positions"] = position_fragmentation();
+
+		// instances are stored in an external list that is not compacted (its indexes are the ids)
+		size_t live_l = 0;
+		for(size_t i = 0 ; i < _instances.size() ; ++ i)
+		{
+			if(_instances.is_valid(i))
+			{
+				++live_l;
+			}
+		}
+		fragmentation_l["instances"] = _instances.size() == 0 ? 0. : 1. - double(live_l) / double(_instances.size());
+		return fragmentation_l;
+	}
+
+	double EntityDrawer::position_fragmentation() const
+	{
+		if(_positions.size() == 0)
+		{
+			return 0.;
+		}
+		return double(_free_positions.size() - _stale_free_positions) / double(_positions.size());
+	}
+
+	void EntityDrawer::compact_positions()
+	{
+		if(_command_queue)
+		{
+			push_command(EntityCommand(EntityCommand::COMPACT_POSITIONS, -1));
+			return;
+		}
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		compact_positions_internal();
+	}
+
+	void EntityDrawer::compact_positions_internal()
+	{
+		if(process_compaction(false) > 0)
+		{
+			_positions_compacted = true;
+		}
+		_compacting = false;
+	}
+
+	size_t EntityDrawer::process_compaction(bool bounded_p)
+	{
+		std::chrono::steady_clock::time_point deadline_l = std::chrono::steady_clock::now()
+			+ std::chrono::microseconds(int64_t(_compaction_time_budget * 1000.));
+
+		size_t size_l = std::min(_positions.size(), _pos_owners.size());
+		size_t moved_l = 0;
+		// slots moved or dropped (bounded by COMPACTION_MAX_SLOTS)
+		size_t slots_l = 0;
+		while(true)
+		{
+			// free slots at the end are dropped (they stay in the heap until they reach its top)
+			while(size_l > 0 && _pos_owners[size_l - 1] < 0 && (!bounded_p || slots_l < COMPACTION_MAX_SLOTS))
+			{
+				--size_l;
+				++_stale_free_positions;
+				++slots_l;
+			}
+			if(_free_positions.empty() || _free_positions.front() >= size_l)
+			{
+				break;
+			}
+			if(bounded_p && (slots_l >= COMPACTION_MAX_SLOTS
+			|| (moved_l > 0 && moved_l % COMPACTION_STEP == 0 && std::chrono::steady_clock::now() >= deadline_l)))
+			{
+				break;
+			}
+			uint32_t to_l = pop_free_position();
+			move_position(uint32_t(size_l - 1), to_l);
+			// the moved slot is the last one : dropped right away (it never was a free slot)
+			--size_l;
+			++moved_l;
+			++slots_l;
+		}
+
+		// only free slots past the buffers are left
+		if(!_free_positions.empty() && _free_positions.front() >= size_l)
+		{
+			_free_positions.clear();
+			_stale_free_positions = 0;
+		}
+		_positions.truncate(size_l);
+		_pos_owners.resize(size_l);
+		return moved_l;
+	}
+
+	void EntityDrawer::push_free_position(uint32_t idx_p)
+	{
+		_free_positions.push_back(idx_p);
+		std::push_heap(_free_positions.begin(), _free_positions.end(), std::greater<uint32_t>());
+	}
+
+	uint32_t EntityDrawer::pop_free_position()
+	{
+		std::pop_heap(_free_positions.begin(), _free_positions.end(), std::greater<uint32_t>());
+		uint32_t idx_l = _free_positions.back();
+		_free_positions.pop_back();
+		return idx_l;
+	}
+
+	void EntityDrawer::move_position(uint32_t from_p, uint32_t to_p)
+	{
+		int owner_l = _pos_owners[from_p];
+		EntityInstance &instance_l = _instances.get(owner_l);
+		PositionIndex &pos_idx_l = instance_l.pos_idx.get();
+		Vector2 pos_l = _positions.state().get(from_p);
+
+		// the slot is respawned : the entity stays at its last published position
+		// until the new slot is acquired (sub instances share the position index)
+		pos_idx_l.spawn = _positions.published().get(from_p);
+		pos_idx_l.birth_tick = _positions.spawn(to_p, pos_l);
+		pos_idx_l.idx = to_p;
+		if(instance_l.dir_handler.is_valid())
+		{
+			instance_l.dir_handler.get().pos_idx = to_p;
+		}
+
+		_pos_owners[to_p] = owner_l;
+		_pos_owners[from_p] = -1;
+	}
+
+	void EntityDrawer::set_shader(Ref<Shader> const &shader_p)
+	{
+		warn_batched("set_shader");
+		_shader = shader_p;
+		if(_material.is_valid())
+		{
+			_material->set_shader(_shader);
+		}
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		for(auto &&pair_l : _instance_materials)
+		{
+			pair_l.second->set_shader(_shader);
+		}
+	}
+
+	RID EntityDrawer::get_material_rid()
+	{
+		if(_material.is_null())
+		{
+			_material = Ref<ShaderMaterial>(memnew(ShaderMaterial));
+			_material->set_shader(_shader);
+		}
+		return _material->get_rid();
+	}
+
+	Ref<ShaderMaterial> EntityDrawer::get_shader_material(int idx_p)
+	{
+		warn_batched("get_shader_material");
+		if(_per_instance_material)
+		{
+			std::lock_guard<std::mutex> lock_l(_internal_mutex);
+			return get_instance_material(idx_p);
+		}
+		WARN_DEPRECATED_MSG("get_shader_material(idx) returns the material shared by all instances, "
+			"use the instance data (set_instance_data, set_shader_bool_param) or enable per_instance_material");
+		get_material_rid();
+		return _material;
+	}
+
+	Ref<ShaderMaterial> EntityDrawer::get_instance_material(int idx_p)
+	{
+		if(!_instances.is_valid(idx_p))
+		{
+			return Ref<ShaderMaterial>();
+		}
+		auto it_l = _instance_materials.find(idx_p);
+		if(it_l != _instance_materials.end())
+		{
+			return it_l->second;
+		}
+		EntityInstance const &instance_l = _instances.get(idx_p);
+		if(!instance_l.animation.is_valid() || !instance_l.animation.get().info.rid.is_valid())
+		{
+			return Ref<ShaderMaterial>();
+		}
+		Ref<ShaderMaterial> material_l = Ref<ShaderMaterial>(memnew(ShaderMaterial));
+		material_l->set_shader(_shader);
+		RenderingServer::get_singleton()->canvas_item_set_material(instance_l.animation.get().info.rid, material_l->get_rid());
+		_instance_materials[idx_p] = material_l;
+		return material_l;
+	}
+
+	void EntityDrawer::set_instance_data_channel_internal(EntityInstance &instance_p, int channel_p, float value_p)
+	{
+		if(instance_p.instance_data[channel_p] == value_p)
+		{
+			return;
+		}
+		instance_p.instance_data[channel_p] = value_p;
+		// force redraw to submit the new data
+		if(instance_p.animation.is_valid())
+		{
+			instance_p.animation.get().drawn = false;
+		}
+	}
+
+	void EntityDrawer::set_instance_data(int idx_p, Color const &data_p)
+	{
+		warn_batched("set_instance_data");
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		if(!_instances.is_valid(idx_p))
+		{
+			return;
+		}
+		EntityInstance &instance_l = _instances.get(idx_p);
+		for(int i = 0 ; i < 4 ; ++ i)
+		{
+			set_instance_data_channel_internal(instance_l, i, data_p[i]);
+		}
+	}
+
+	Color EntityDrawer::get_instance_data(int idx_p) const
+	{
+		if(!_instances.is_valid(idx_p))
+		{
+			return Color(1, 1, 1, 1);
+		}
+		return _instances.get(idx_p).instance_data;
+	}
+
+	void EntityDrawer::set_instance_data_channel(int channel_p, PackedFloat32Array const &values_p)
+	{
+		warn_batched("set_instance_data_channel");
+		if(channel_p < 0 || channel_p > 3)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		float const *values_l = values_p.ptr();
+		int64_t size_l = values_p.size();
+		_instances.for_each([&](EntityInstance & instance_p, size_t idx_p) {
+			if(int64_t(idx_p) < size_l)
+			{
+				set_instance_data_channel_internal(instance_p, channel_p, values_l[idx_p]);
+			}
+		});
+	}
+
+	void EntityDrawer::set_instance_data_flags(int channel_p, PackedByteArray const &values_p)
+	{
+		warn_batched("set_instance_data_flags");
+		if(channel_p < 0 || channel_p > 3)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		uint8_t const *values_l = values_p.ptr();
+		int64_t size_l = values_p.size();
+		_instances.for_each([&](EntityInstance & instance_p, size_t idx_p) {
+			if(int64_t(idx_p) < size_l)
+			{
+				set_instance_data_channel_internal(instance_p, channel_p, values_l[idx_p] ? 1.f : 0.f);
+			}
+		});
+	}
+
+	void EntityDrawer::set_instance_data_from_indexes(int channel_p, PackedInt32Array const &indexes_p, float value_indexes_p)
+	{
+		warn_batched("set_instance_data_from_indexes");
+		if(channel_p < 0 || channel_p > 3)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		int32_t const *indexes_l = indexes_p.ptr();
+		for(int64_t i = 0 ; i < indexes_p.size() ; ++ i)
+		{
+			if(_instances.is_valid(indexes_l[i]))
+			{
+				set_instance_data_channel_internal(_instances.get(indexes_l[i]), channel_p, value_indexes_p);
+			}
+		}
+	}
+
+	void EntityDrawer::set_all_instance_data_from_indexes(int channel_p, PackedInt32Array const &indexes_p, float value_indexes_p, float value_others_p)
+	{
+		warn_batched("set_all_instance_data_from_indexes");
+		if(channel_p < 0 || channel_p > 3)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		// set all default values
+		_instances.for_each([&](EntityInstance & instance_p, size_t ) {
+			set_instance_data_channel_internal(instance_p, channel_p, value_others_p);
+		});
+
+		// set for indexes
+		int32_t const *indexes_l = indexes_p.ptr();
+		for(int64_t i = 0 ; i < indexes_p.size() ; ++ i)
+		{
+			if(_instances.is_valid(indexes_l[i]))
+			{
+				set_instance_data_channel_internal(_instances.get(indexes_l[i]), channel_p, value_indexes_p);
+			}
+		}
+	}
+
+	void EntityDrawer::map_shader_param(String const &param_p, int channel_p)
+	{
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		if(channel_p < 0 || channel_p > 3)
+		{
+			_param_channels.erase(StringName(param_p));
+			return;
+		}
+		_param_channels[StringName(param_p)] = channel_p;
+	}
+
+	int EntityDrawer::get_param_channel(String const &param_p)
+	{
+		StringName name_l(param_p);
+		auto it_l = _param_channels.find(name_l);
+		if(it_l != _param_channels.end())
+		{
+			return it_l->second;
+		}
+		// map to the first channel not used by another param
+		bool used_l[4] = {false, false, false, false};
+		for(auto &&pair_l : _param_channels)
+		{
+			used_l[pair_l.second] = true;
+		}
+		for(int channel_l = 0 ; channel_l < 4 ; ++ channel_l)
+		{
+			if(!used_l[channel_l])
+			{
+				_param_channels[name_l] = channel_l;
+				WARN_PRINT(String("shader param ") + param_p + " mapped to instance data channel " + String::num_int64(channel_l)
+					+ " (the shader must read it from COLOR, see map_shader_param and per_instance_material)");
+				return channel_l;
+			}
+		}
+		ERR_FAIL_V_MSG(-1, String("all instance data channels are mapped, cannot map shader param ") + param_p + " (see map_shader_param)");
+	}
+
+	void EntityDrawer::set_shader_bool_param(int idx_p, String const &param_p, bool value_p)
+	{
+		warn_batched("set_shader_bool_param");
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		if(_per_instance_material)
+		{
+			Ref<ShaderMaterial> material_l = get_instance_material(idx_p);
+			if(material_l.is_valid())
+			{
+				material_l->set_shader_parameter(param_p, value_p);
+			}
+			return;
+		}
+		int channel_l = get_param_channel(param_p);
+		if(channel_l < 0)
+		{
+			return;
+		}
+		if(_instances.is_valid(idx_p))
+		{
+			set_instance_data_channel_internal(_instances.get(idx_p), channel_l, value_p ? 1.f : 0.f);
+		}
+	}
+
+	void EntityDrawer::set_shader_bool_params(String const &param_p, TypedArray<bool> const &values_p)
+	{
+		warn_batched("set_shader_bool_params");
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		int64_t size_l = values_p.size();
+		if(_per_instance_material)
+		{
+			for(int64_t i = 0 ; i < size_l ; ++ i)
+			{
+				Ref<ShaderMaterial> material_l = get_instance_material(int(i));
+				if(material_l.is_valid())
+				{
+					material_l->set_shader_parameter(param_p, values_p[i]);
+				}
+			}
+			return;
+		}
+		int channel_l = get_param_channel(param_p);
+		if(channel_l < 0)
+		{
+			return;
+		}
+		_instances.for_each([&](EntityInstance & instance_p, size_t idx_p) {
+			if(int64_t(idx_p) < size_l)
+			{
+				set_instance_data_channel_internal(instance_p, channel_l, bool(values_p[idx_p]) ? 1.f : 0.f);
+			}
+		});
+	}
+
+	void EntityDrawer::set_shader_bool_params_from_indexes(String const &param_p, TypedArray<int> const &indexes_p, bool value_indexes_p)
+	{
+		warn_batched("set_shader_bool_params_from_indexes");
+		int channel_l = -1;
+		{
+			std::lock_guard<std::mutex> lock_l(_internal_mutex);
+			if(_per_instance_material)
+			{
+				for(int64_t i = 0 ; i < indexes_p.size() ; ++ i)
+				{
+					Ref<ShaderMaterial> material_l = get_instance_material(int(indexes_p[i]));
+					if(material_l.is_valid())
+					{
+						material_l->set_shader_parameter(param_p, value_indexes_p);
+					}
+				}
+				return;
+			}
+			channel_l = get_param_channel(param_p);
+		}
+		if(channel_l < 0)
+		{
+			return;
+		}
+		PackedInt32Array indexes_l;
+		for(int64_t i = 0 ; i < indexes_p.size() ; ++ i)
+		{
+			indexes_l.push_back(int(indexes_p[i]));
+		}
+		set_instance_data_from_indexes(channel_l, indexes_l, value_indexes_p ? 1.f : 0.f);
+	}
+
+	void EntityDrawer::set_all_shader_bool_params_from_indexes(String const &param_p, TypedArray<int> const &indexes_p, bool value_indexes_p, bool value_others_p)
+	{
+		warn_batched("set_all_shader_bool_params_from_indexes");
+		int channel_l = -1;
+		{
+			std::lock_guard<std::mutex> lock_l(_internal_mutex);
+			if(_per_instance_material)
+			{
+				_instances.for_each([&](EntityInstance &, size_t idx_p) {
+					Ref<ShaderMaterial> material_l = get_instance_material(int(idx_p));
+					if(material_l.is_valid())
+					{
+						material_l->set_shader_parameter(param_p, value_others_p);
+					}
+				});
+				for(int64_t i = 0 ; i < indexes_p.size() ; ++ i)
+				{
+					Ref<ShaderMaterial> material_l = get_instance_material(int(indexes_p[i]));
+					if(material_l.is_valid())
+					{
+						material_l->set_shader_parameter(param_p, value_indexes_p);
+					}
+				}
+				return;
+			}
+			channel_l = get_param_channel(param_p);
+		}
+		if(channel_l < 0)
+		{
+			return;
+		}
+		PackedInt32Array indexes_l;
+		for(int64_t i = 0 ; i < indexes_p.size() ; ++ i)
+		{
+			indexes_l.push_back(int(indexes_p[i]));
+		}
+		set_all_instance_data_from_indexes(channel_l, indexes_l, value_indexes_p ? 1.f : 0.f, value_others_p ? 1.f : 0.f);
+	}
+
+	TypedArray<int> EntityDrawer::indexes_from_texture(Rect2 const &rect_p) const
+	{
+		PackedInt32Array picked_l = packed_indexes_from_texture(rect_p);
+
+		TypedArray<int> indexes_l;
+		indexes_l.resize(picked_l.size());
+		int32_t const *ptr_l = picked_l.ptr();
+		for(int64_t i = 0 ; i < picked_l.size() ; ++ i)
+		{
+			indexes_l[i] = ptr_l[i];
+		}
+
+		return indexes_l;
 	}
 
 	TypedArray<bool> EntityDrawer::index_array_from_texture(Rect2 const &rect_p) const
 	{
-		if(!_texture_catcher)
+		if(_picking_mode != PICKING_CPU && !_texture_catcher)
+		{
+			return TypedArray<bool>();
+		}
+		PackedInt32Array picked_l = packed_indexes_from_texture(rect_p);
+
+		TypedArray<bool> all_added_l;
+		all_added_l.resize(_instances.size());
+		all_added_l.fill(false);
+		int32_t const *ptr_l = picked_l.ptr();
+		for(int64_t i = 0 ; i < picked_l.size() ; ++ i)
+		{
+			all_added_l[ptr_l[i]] = true;
+		}
+		return all_added_l;
+	}
+
+	PackedInt32Array EntityDrawer::packed_indexes_from_texture(Rect2 const &rect_p) const
+	{
+		if(_picking_mode == PICKING_CPU)
+		{
+			return indexes_from_masks(rect_p);
+		}
+		if(!_texture_catcher)
+		{
+			return PackedInt32Array();
+		}
+		// scale from texture viewport scale
+		double scale_l = _texture_catcher->get_scale_viewport();
+		read_picking_buffer();
+		Rect2i scale_rect_l = Rect2i((rect_p.get_position() - _picking_buffer_origin) / scale_l, rect_p.get_size() / scale_l);
+		return _picking_buffer.indexes_in_rect(scale_rect_l, int(_instances.size()));
+	}
+
+	void EntityDrawer::read_picking_buffer() const
+	{
+		if(_picking_buffer_locked)
+		{
+			return;
+		}
+		// on demand : read back only when a new render is available
+		if(_texture_catcher->is_on_demand()
+		&& _picking_buffer_version == _texture_catcher->get_version())
+		{
+			return;
+		}
+		_picking_buffer.set_image(_texture_catcher->get_texture()->get_image());
+		_picking_buffer_version = _texture_catcher->get_version();
+		_picking_buffer_origin = _texture_catcher->get_rendered_origin();
+		_picking_buffer_frame = Engine::get_singleton()->get_process_frames();
+	}
+
+	bool EntityDrawer::request_picking_readback()
+	{
+		RenderingDevice *device_l = RenderingServer::get_singleton()->get_rendering_device();
+		if(!device_l)
+		{
+			return false;
+		}
+		RID texture_l = RenderingServer::get_singleton()->texture_get_rd_texture(_texture_catcher->get_texture()->get_rid());
+		if(!texture_l.is_valid()
+		|| device_l->texture_get_data_async(texture_l, 0, Callable(this, "_on_picking_readback")) != OK)
+		{
+			return false;
+		}
+		_readback_in_flight = true;
+		_readback_version = _texture_catcher->get_version();
+		_readback_frame = Engine::get_singleton()->get_process_frames();
+		_readback_origin = _texture_catcher->get_rendered_origin();
+		_readback_size = _texture_catcher->get_texture_size();
+		return true;
+	}
+
+	void EntityDrawer::_on_picking_readback(PackedByteArray const &data_p)
+	{
+		std::lock_guard<std::mutex> lock_l(_readback_mutex);
+		_readback_data = data_p;
+		_readback_received = true;
+	}
+
+	void EntityDrawer::apply_picking_readback()
+	{
+		PackedByteArray data_l;
+		{
+			std::lock_guard<std::mutex> lock_l(_readback_mutex);
+			if(!_readback_received)
+			{
+				return;
+			}
+			_readback_received = false;
+			data_l = _readback_data;
+			_readback_data = PackedByteArray();
+		}
+		_readback_in_flight = false;
+		// a blocking read back may have happened since
+		if(_readback_frame <= _picking_buffer_frame && _picking_buffer_frame > 0)
+		{
+			return;
+		}
+		if(_picking_buffer.set_data(data_l, _readback_size.x, _readback_size.y))
+		{
+			_picking_buffer_version = _readback_version;
+			_picking_buffer_origin = _readback_origin;
+			_picking_buffer_frame = _readback_frame;
+		}
+	}
+
+	bool EntityDrawer::is_picking_buffer_ready(PickRequest const &request_p) const
+	{
+		// on demand the version identifies the render, else the texture is rendered every frame
+		if(_texture_catcher->is_on_demand())
+		{
+			return _picking_buffer_version != uint64_t(-1) && _picking_buffer_version >= request_p.version;
+		}
+		return _picking_buffer_frame > request_p.frame;
+	}
+
+	int EntityDrawer::request_pick(Vector2 const &pos_p, int tolerance_p)
+	{
+		PickRequest request_l;
+		request_l.pos = pos_p;
+		request_l.tolerance = tolerance_p;
+		double scale_l = _texture_catcher ? _texture_catcher->get_scale_viewport() : 1.;
+		double range_l = (std::max(tolerance_p, 1) + 1) * scale_l;
+		return add_pick_request(request_l, Rect2(pos_p - Vector2(range_l, range_l), Vector2(range_l, range_l) * 2.));
+	}
+
+	int EntityDrawer::request_pick_rect(Rect2 const &rect_p)
+	{
+		PickRequest request_l;
+		request_l.is_rect = true;
+		request_l.rect = rect_p;
+		return add_pick_request(request_l, rect_p);
+	}
+
+	int EntityDrawer::add_pick_request(PickRequest &request_p, Rect2 const &region_p)
+	{
+		request_p.ticket = _next_pick_ticket++;
+		request_p.frame = Engine::get_singleton()->get_process_frames();
+		if(_picking_mode == PICKING_TEXTURE && _texture_catcher && _texture_catcher->is_on_demand())
+		{
+			// wait for the render of the region if any
+			request_p.version = _texture_catcher->request_update(region_p);
+		}
+		_pick_requests.push_back(request_p);
+		return request_p.ticket;
+	}
+
+	bool EntityDrawer::is_pick_ready(int ticket_p) const
+	{
+		return _pick_results.find(ticket_p) != _pick_results.end();
+	}
+
+	PackedInt32Array EntityDrawer::get_pick_result(int ticket_p)
+	{
+		auto it_l = _pick_results.find(ticket_p);
+		if(it_l == _pick_results.end())
+		{
+			return PackedInt32Array();
+		}
+		PackedInt32Array indexes_l = it_l->second.indexes;
+		_pick_results.erase(it_l);
+		return indexes_l;
+	}
+
+	void EntityDrawer::resolve_pick_requests(std::vector<int> &resolved_p)
+	{
+		uint64_t frame_l = Engine::get_singleton()->get_process_frames();
+		// results not fetched are dropped after a while
+		for(auto it_l = _pick_results.begin() ; it_l != _pick_results.end() ; )
+		{
+			if(frame_l > it_l->second.frame + PICK_RESULT_FRAMES)
+			{
+				it_l = _pick_results.erase(it_l);
+			}
+			else
+			{
+				++it_l;
+			}
+		}
+		if(_pick_requests.empty())
+		{
+			return;
+		}
+
+		bool texture_l = _picking_mode == PICKING_TEXTURE && _texture_catcher;
+		if(texture_l)
+		{
+			apply_picking_readback();
+			// read back lost (texture freed or resized) : request it again
+			if(_readback_in_flight && frame_l > _readback_frame + PICK_RESULT_FRAMES)
+			{
+				_readback_in_flight = false;
+			}
+			// a render newer than the buffer is available for a request
+			bool outdated_l = false;
+			for(PickRequest const &request_l : _pick_requests)
+			{
+				outdated_l |= !is_picking_buffer_ready(request_l)
+					&& frame_l > request_l.frame
+					&& _texture_catcher->get_version() >= request_l.version;
+			}
+			// the render being resized is read back once available
+			if(outdated_l && !_readback_in_flight && !_texture_catcher->is_pending()
+			&& !request_picking_readback())
+			{
+				// compatibility renderer : blocking read back
+				read_picking_buffer();
+			}
+		}
+
+		std::vector<PickRequest> ready_l;
+		auto end_l = std::remove_if(_pick_requests.begin(), _pick_requests.end(), [&](PickRequest const &request_p) {
+			// at least one frame of latency for the render to be done
+			bool ready_p = frame_l > request_p.frame
+				&& (!texture_l || is_picking_buffer_ready(request_p)
+					|| frame_l > request_p.frame + PICK_RESULT_FRAMES);
+			if(ready_p)
+			{
+				ready_l.push_back(request_p);
+			}
+			return ready_p;
+		});
+		_pick_requests.erase(end_l, _pick_requests.end());
+		if(ready_l.empty())
+		{
+			return;
+		}
+
+		// all requests use the buffer read back
+		_picking_buffer_locked = texture_l;
+		for(PickRequest const &request_l : ready_l)
+		{
+			PickResult result_l;
+			result_l.frame = frame_l;
+			if(request_l.is_rect)
+			{
+				result_l.indexes = packed_indexes_from_texture(request_l.rect);
+			}
+			else
+			{
+				int idx_l = index_from_texture_with_tolerance(request_l.pos, request_l.tolerance);
+				if(idx_l >= 0)
+				{
+					result_l.indexes.push_back(idx_l);
+				}
+			}
+			_pick_results[request_l.ticket] = result_l;
+			resolved_p.push_back(request_l.ticket);
+		}
+		_picking_buffer_locked = false;
+	}
+
+	void EntityDrawer::set_picking_on_demand(bool on_demand_p)
+	{
+		_picking_on_demand = on_demand_p;
+		if(_texture_catcher)
+		{
+			_texture_catcher->set_on_demand(on_demand_p);
+		}
+	}
+
+	void EntityDrawer::request_picking(Rect2 const &rect_p)
+	{
+		if(_texture_catcher)
+		{
+			_texture_catcher->request_update(rect_p);
+		}
+	}
+
+	int EntityDrawer::index_from_texture(Vector2 const &pos_p) const
+	{
+		return index_from_texture_with_tolerance(pos_p, 0);
+	}
+
+	int EntityDrawer::index_from_texture_with_tolerance(Vector2 const &pos_p, int tolerance_p) const
+	{
+		if(_picking_mode == PICKING_CPU)
+		{
+			return index_from_masks(pos_p, tolerance_p);
+		}
+		if(!_texture_catcher)
+		{
+			return -1;
+		}
+		// scale from texture viewport scale
+		double scale_l = _texture_catcher->get_scale_viewport();
+		read_picking_buffer();
+		Vector2 scale_pos_l = (pos_p - _picking_buffer_origin) / scale_l;
+		int idx_l = _picking_buffer.index_at(scale_pos_l.x, scale_pos_l.y);
+		if(idx_l >= 0)
+		{
+			return idx_l;
+		}
+		for(size_t range_l = 1; range_l < tolerance_p; ++ range_l)
+		{
+			for(size_t x = 0 ; x <= range_l ; ++x)
+			{
+				for(size_t y = 0 ; y <= range_l ; ++y)
+				{
+					if(x+y == 0 || x+y > range_l) { continue; }
+					idx_l = _picking_buffer.index_at(scale_pos_l.x+x, scale_pos_l.y+y);
+					if(idx_l >= 0) { return idx_l; }
+					idx_l = _picking_buffer.index_at(scale_pos_l.x-x, scale_pos_l.y+y);
+					if(idx_l >= 0) { return idx_l; }
+					idx_l = _picking_buffer.index_at(scale_pos_l.x-x, scale_pos_l.y-y);
+					if(idx_l >= 0) { return idx_l; }
+					idx_l = _picking_buffer.index_at(scale_pos_l.x+x, scale_pos_l.y-y);
+					if(idx_l >= 0) { return idx_l; }
+				}
+			}
+		}
+		return -1;
+	}
+	void EntityDrawer::set_picking_mode(int picking_mode_p)
+	{
+		_picking_mode = picking_mode_p;
+		if(_picking_mode == PICKING_CPU)
+		{
+			frames_table().set_bake_masks(true);
+		}
+	}
+
+	template<typename func_t>
+	void EntityDrawer::for_each_pickable(Rect2 const &rect_p, func_t &&func_p) const
+	{
+		BakedFramesTable const &table_l = frames_table();
+		auto visit_l = [&](int idx_p) {
+			EntityInstance const &instance_l = _instances.get(idx_p);
+			if(instance_l.alt_info.is_valid()
+			&& instance_l.animation.is_valid()
+			&& instance_l.animation.get().drawn_frame >= 0)
+			{
+				AnimationInstance const &animation_l = instance_l.animation.get();
+				BakedFrame const &frame_l = table_l.get_frame(animation_l.drawn_frame);
+				Rect2 frame_rect_l(animation_l.drawn_pos + animation_l.drawn_offset + frame_l.region.margin, frame_l.region.size);
+				func_p(idx_p, animation_l, frame_l, frame_rect_l);
+			}
+		};
+		// positions in the grid may differ from the drawn ones (interpolation)
+		std::lock_guard<std::mutex> lock_grid_l(_grid_mutex);
+		_grid.query(rect_p.grow(_picking_margin), [&](size_t pos_idx_p) {
+			int owner_l = pos_idx_p < _pos_owners.size() ? _pos_owners[pos_idx_p] : -1;
+			if(owner_l < 0 || !_instances.is_valid(owner_l))
+			{
+				return;
+			}
+			visit_l(owner_l);
+			for(smart_list_handle<EntityInstance> const &sub_l : _instances.get(owner_l).sub_instances)
+			{
+				if(sub_l.is_valid())
+				{
+					visit_l(int(sub_l.handle()));
+				}
+			}
+		});
+	}
+
+	bool EntityDrawer::hit_mask(BakedFrame const &frame_p, Rect2 const &frame_rect_p, Vector2 const &pos_p)
+	{
+		Vector2 local_l = pos_p - frame_rect_p.get_position();
+		if(local_l.x < 0 || local_l.y < 0
+		|| local_l.x >= frame_rect_p.get_size().x || local_l.y >= frame_rect_p.get_size().y)
+		{
+			return false;
+		}
+		// no mask baked : test the rect only
+		if(frame_p.mask.is_null())
+		{
+			return true;
+		}
+		Vector2i pixel_l(int(local_l.x), int(local_l.y));
+		Vector2i size_l = frame_p.mask->get_size();
+		return pixel_l.x < size_l.x && pixel_l.y < size_l.y && frame_p.mask->get_bitv(pixel_l);
+	}
+
+	int EntityDrawer::index_from_masks(Vector2 const &pos_p, int tolerance_p) const
+	{
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+
+		Vector2 local_l = get_global_transform_with_canvas().affine_inverse().xform(pos_p);
+		int range_max_l = std::max(tolerance_p - 1, 0);
+
+		// gather candidates once
+		struct Candidate
+		{
+			int idx;
+			AnimationInstance const *animation;
+			BakedFrame const *frame;
+			Rect2 rect;
+		};
+		std::vector<Candidate> candidates_l;
+		for_each_pickable(Rect2(local_l, Vector2()).grow(range_max_l), [&](int idx_p, AnimationInstance const &animation_p, BakedFrame const &frame_p, Rect2 const &rect_p) {
+			candidates_l.push_back({idx_p, &animation_p, &frame_p, rect_p});
+		});
+
+		// closest range first, the entity drawn on top wins
+		for(int range_l = 0 ; range_l <= range_max_l ; ++ range_l)
+		{
+			Candidate const *best_l = nullptr;
+			for(int x = -range_l ; x <= range_l ; ++ x)
+			{
+				int y_range_l = range_l - std::abs(x);
+				for(int y : {-y_range_l, y_range_l})
+				{
+					Vector2 test_l = local_l + Vector2(x, y);
+					for(Candidate const &candidate_l : candidates_l)
+					{
+						if(hit_mask(*candidate_l.frame, candidate_l.rect, test_l)
+						&& (!best_l
+							|| candidate_l.animation->z_index > best_l->animation->z_index
+							|| (candidate_l.animation->z_index == best_l->animation->z_index
+								&& candidate_l.animation->drawn_pos.y > best_l->animation->drawn_pos.y)))
+						{
+							best_l = &candidate_l;
+						}
+					}
+					if(y_range_l == 0)
+					{
+						break;
+					}
+				}
+			}
+			if(best_l)
+			{
+				return best_l->idx;
+			}
+		}
+		return -1;
+	}
+
+	PackedInt32Array EntityDrawer::indexes_from_masks(Rect2 const &rect_p) const
+	{
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+
+		PackedInt32Array indexes_l;
+
+		// bounding rect in local coordinates
+		Transform2D screen_to_local_l = get_global_transform_with_canvas().affine_inverse();
+		Vector2 corners_l[4] = {
+			rect_p.get_position(),
+			rect_p.get_position() + Vector2(rect_p.get_size().x, 0),
+			rect_p.get_position() + Vector2(0, rect_p.get_size().y),
+			rect_p.get_position() + rect_p.get_size()
+		};
+		Rect2 local_rect_l(screen_to_local_l.xform(corners_l[0]), Vector2());
+		for(int i = 1 ; i < 4 ; ++ i)
+		{
+			local_rect_l.expand_to(screen_to_local_l.xform(corners_l[i]));
+		}
+
+		for_each_pickable(local_rect_l, [&](int idx_p, AnimationInstance const &, BakedFrame const &frame_p, Rect2 const &frame_rect_p) {
+			if(!frame_rect_p.intersects(local_rect_l, true))
+			{
+				return;
+			}
+			if(frame_p.mask.is_null())
+			{
+				indexes_l.push_back(idx_p);
+				return;
+			}
+			// test every pixel of the mask in the rect
+			Rect2 clip_l = frame_rect_p.intersection(local_rect_l);
+			Vector2 start_l = clip_l.get_position() - frame_rect_p.get_position();
+			Vector2 end_l = start_l + clip_l.get_size();
+			Vector2i size_l = frame_p.mask->get_size();
+			for(int x = int(start_l.x) ; x <= std::min(int(end_l.x), size_l.x - 1) ; ++ x)
+			{
+				for(int y = int(start_l.y) ; y <= std::min(int(end_l.y), size_l.y - 1) ; ++ y)
+				{
+					if(frame_p.mask->get_bitv(Vector2i(x, y)))
+					{
+						indexes_l.push_back(idx_p);
+						return;
+					}
+				}
+			}
+		});
+		return indexes_l;
+	}
+
+	void EntityDrawer::_notification(int p_notification)
+	{
+		switch (p_notification) {
+			case NOTIFICATION_PROCESS: {
+				_process(get_process_delta_time());
+			} break;
+			case NOTIFICATION_PHYSICS_PROCESS: {
+				_physics_process(get_physics_process_delta_time());
+			} break;
+			case NOTIFICATION_DRAW: {
+				_draw();
+			} break;
+			case NOTIFICATION_READY: {
+				_ready();
+				set_process(true);
+				set_physics_process(true);
+			} break;
+		}
+	}
+
+	void EntityDrawer::_ready()
+	{
+		// Custom shader to display a color per idx
+		_alt_shader = Ref<Shader>(memnew(Shader));
+		_alt_shader->set_code("\n\
+			shader_type canvas_item;\n\
+			\n\
+			varying flat vec3 idx_color;\n\
+			\n\
+			void vertex() {\n\
+				idx_color = round(COLOR.rgb * 255.0) / 255.0;\n\
+			}\n\
+			\n\
+			void fragment() {\n\
+				COLOR.rgb = idx_color;\n\
+				COLOR.a = round(texture(TEXTURE, UV).a);\n\
+			}\n\
+			"
+		);
+		_alt_material = Ref<ShaderMaterial>(memnew(ShaderMaterial));
+		_alt_material->set_shader(_alt_shader);
+
+		// only switch to the library table if no frame has been baked yet
+		if(!_frames_library_path.is_empty() && _instances.size() == 0)
+		{
+			_frames_library = Object::cast_to<FramesLibrary>(get_node(_frames_library_path));
+		}
+
+		// cpu picking does not require the picking viewport
+		if(_picking_mode == PICKING_CPU)
+		{
+			frames_table().set_bake_masks(true);
+			return;
+		}
+
+		_texture_catcher = memnew(TextureCatcher);
+		_texture_catcher->set_scale_viewport(_scale_viewport);
+		_texture_catcher->set_on_demand(_picking_on_demand);
+		if(!_ref_camera_path.is_empty())
+		{
+			_texture_catcher->set_ref_camera("../"+_ref_camera_path);
+		}
+		add_child(_texture_catcher);
+	}
+
+	/// @brief id of the animation to display in the baked table (-1 if none)
+	/// specialized for the component mask of the instance (components known to be present)
+	template<int mask_t>
+	int get_anim_id(EntityInstance const &instance_p)
+	{
+		AnimationInstance const &animation_l = instance_p.animation.get();
+		if constexpr((mask_t & EntityDrawer::COMPONENT_DIRECTIONAL) == 0)
+		{
+			return animation_l.current_id;
+		}
+		else
+		{
+			DirectionHandler const &handler_l = instance_p.dir_handler.get();
+			int type_l = handler_l.type == DirectionHandler::NONE ? DirectionHandler::LEFT : handler_l.type;
+			DirectionalAnimation const *dir_l = instance_p.dir_animation.is_valid()
+				&& !instance_p.dir_animation.get().base_name.is_empty() ? &instance_p.dir_animation.get() : nullptr;
+
+			// forced directionl anim
+			if(dir_l && animation_l.has_priority)
+			{
+				return dir_l->ids[type_l];
+			}
+			if constexpr((mask_t & EntityDrawer::COMPONENT_DYNAMIC) != 0)
+			{
+				DynamicAnimation const &dyn_l = instance_p.dyn_animation.get();
+				if(handler_l.idle)
+				{
+					// non-forced directionl anim
+					return dir_l ? dir_l->ids[type_l] : dyn_l.idle.ids[type_l];
+				}
+				return dyn_l.moving.ids[type_l];
+			}
+			return animation_l.current_id;
+		}
+	}
+
+	/// @brief get_anim_id for a component mask known at runtime only
+	int get_anim_id_dispatch(EntityInstance const &instance_p)
+	{
+		static int (* const get_anim_id_l[EntityDrawer::COMPONENT_MASK_COUNT])(EntityInstance const &) = {
+			&get_anim_id<0>,
+			&get_anim_id<1>,
+			&get_anim_id<2>,
+			&get_anim_id<3>,
+			&get_anim_id<4>,
+			&get_anim_id<5>,
+			&get_anim_id<6>,
+			&get_anim_id<7>,
+		};
+		return get_anim_id_l[instance_p.components](instance_p);
+	}
+
+	void EntityDrawer::update_animation_timers(BakedFramesTable const &table_p)
+	{
+		// schedule animations (re)started since last draw
+		{
+			std::lock_guard<std::mutex> lock_l(_internal_mutex);
+			std::swap(_to_schedule, _scheduling);
+		}
+		_scheduling.insert(_scheduling.end(), _retry_schedule.begin(), _retry_schedule.end());
+		_retry_schedule.clear();
+		for(int idx_l : _scheduling)
+		{
+			if(_instances.is_valid(idx_l) && _instances.get(idx_l).animation.is_valid())
+			{
+				schedule_animation(idx_l, _instances.get(idx_l), table_p);
+			}
+		}
+		_scheduling.clear();
+
+		// only animations which frame is over are updated
+		_timer_wheel.pop_due(_elapsedAllTime, _due_timers);
+		_due_updates.assign(_due_timers.size(), ANIMATION_NONE);
+		run_parallel(&EntityDrawer::advance_animation_task, _due_timers.size(), "EntityDrawer::advance_animation");
+
+		// apply results
+		for(size_t i = 0 ; i < _due_timers.size() ; ++ i)
+		{
+			int idx_l = _due_timers[i].idx;
+			switch(_due_updates[i])
+			{
+				case ANIMATION_SCHEDULE:
+					schedule_animation(idx_l, _instances.get(idx_l), table_p);
+					break;
+				case ANIMATION_RETRY:
+					_retry_schedule.push_back(idx_l);
+					break;
+				case ANIMATION_FREE:
+					// freed at the end of the draw
+					_instances.get(idx_l).animation.get().freeing = true;
+					_deferred_frees.push_back(_instances.get_handle(idx_l));
+					break;
+				default:
+					break;
+			}
+		}
+	}
+
+	void EntityDrawer::schedule_animation(int idx_p, EntityInstance &instance_p, BakedFramesTable const &table_p)
+	{
+		AnimationInstance &animation_l = instance_p.animation.get();
+		// invalidate any previous timer
+		animation_l.timer_stamp = ++_timer_stamp;
+
+		int anim_id_l = get_anim_id_dispatch(instance_p);
+		if(anim_id_l < 0 || table_p.get_animation(anim_id_l).frame_count == 0)
+		{
+			// animation may become valid later (direction or dynamic animation)
+			_retry_schedule.push_back(idx_p);
+			return;
+		}
+		BakedAnimation const &baked_l = table_p.get_animation(anim_id_l);
+		// current animation may have changed for a shorter one (direction)
+		int frame_idx_l = std::min(animation_l.frame_idx, baked_l.frame_count - 1);
+		_timer_wheel.schedule(animation_l.start + table_p.get_frame(baked_l, frame_idx_l).duration, idx_p, animation_l.timer_stamp);
+	}
+
+	void EntityDrawer::advance_animation_task(void *drawer_p, uint32_t i)
+	{
+		EntityDrawer *drawer_l = static_cast<EntityDrawer *>(drawer_p);
+		TimerEntry const &timer_l = drawer_l->_due_timers[i];
+		if(!drawer_l->_instances.is_valid(timer_l.idx))
+		{
+			return;
+		}
+		EntityInstance &instance_l = drawer_l->_instances.get(timer_l.idx);
+		// outdated timer
+		if(!instance_l.animation.is_valid()
+		|| instance_l.animation.get().timer_stamp != timer_l.stamp)
+		{
+			return;
+		}
+		drawer_l->_due_updates[i] = drawer_l->advance_animation(instance_l, drawer_l->frames_table());
+	}
+
+	EntityDrawer::AnimationUpdate EntityDrawer::advance_animation(EntityInstance &instance_p, BakedFramesTable const &table_p)
+	{
+		AnimationInstance & animation_l = instance_p.animation.get();
+		// out of camera : animation will catch up when back in view
+		if(!is_visible_position(instance_p.pos_idx.get()) && !animation_l.one_shot)
+		{
+			animation_l.culled = true;
+			return ANIMATION_NONE;
+		}
+		int anim_id_l = get_anim_id_dispatch(instance_p);
+		if(anim_id_l < 0 || table_p.get_animation(anim_id_l).frame_count == 0)
+		{
+			return ANIMATION_RETRY;
+		}
+		++animation_l.frame_idx;
+		animation_l.start = _elapsedAllTime;
+		if(animation_l.frame_idx >= table_p.get_animation(anim_id_l).frame_count)
+		{
+			if(animation_l.one_shot)
+			{
+				return ANIMATION_FREE;
+			}
+			else if(!animation_l.next_animation.is_empty())
+			{
+				restart_animation(instance_p, animation_l.next_animation, StringName());
+			}
+			// if dynamic animation and no chaining we reset
+			else if(instance_p.dyn_animation.is_valid())
+			{
+				restart_animation(instance_p, StringName(), StringName());
+			}
+			animation_l.frame_idx = 0;
+		}
+		return ANIMATION_SCHEDULE;
+	}
+
+	template<int mask_t>
+	void EntityDrawer::prepare_draw_command_task(void *drawer_p, uint32_t i)
+	{
+		EntityDrawer *drawer_l = static_cast<EntityDrawer *>(drawer_p);
+		drawer_l->prepare_draw_command<mask_t>(drawer_l->_draw_commands[drawer_l->_mask_group_offset + i], drawer_l->frames_table());
+	}
+
+	template<int mask_t>
+	void EntityDrawer::prepare_draw_command(DrawCommand &command_p, BakedFramesTable const &table_p)
+	{
+		EntityInstance &instance_l = _instances.get(command_p.idx);
+		AnimationInstance & animation_l = instance_l.animation.get();
+		// not drawn unless a frame is found
+		animation_l.drawn_frame = -1;
+		// waiting for destruction
+		if(animation_l.freeing
+		|| (instance_l.main_instance.is_valid()
+			&& instance_l.main_instance.get().animation.is_valid()
+			&& instance_l.main_instance.get().animation.get().freeing))
 		{
-			return TypedArray<bool>();
+			return;
 		}
-		// scale from texture viewport scale
-		double scale_l = _texture_catcher->get_scale_viewport();
-		Rect2i scale_rect_l = Rect2i(rect_p.get_position() / scale_l, rect_p.get_size() / scale_l);
-		Ref<Image> image_l = _texture_catcher->get_texture()->get_image();
-		TypedArray<bool> all_added_l;
-		all_added_l.resize(_instances.size());
-		all_added_l.fill(false);
-		for(int32_t x = scale_rect_l.get_position().x ; x <= scale_rect_l.get_position().x + scale_rect_l.get_size().x ; ++ x)
+		// out of camera : skip (one shot animations must be updated to be freed)
+		if(!is_visible_position(instance_l.pos_idx.get()) && !animation_l.one_shot)
 		{
-			for(int32_t y = scale_rect_l.get_position().y ; y <= scale_rect_l.get_position().y + scale_rect_l.get_size().y ; ++ y)
+			animation_l.culled = true;
+			// last frame submitted is still displayed : clear it once
+			if(animation_l.drawn)
 			{
-				int idx_l = idx_from_color(safe_color(x, y, image_l));
-				if(idx_l >= 0)
-				{
-					all_added_l[idx_l] = true;
-				}
+				animation_l.drawn = false;
+				command_p.hide = true;
 			}
+			return;
 		}
-		return all_added_l;
+		int anim_id_l = get_anim_id<mask_t>(instance_l);
+		if(anim_id_l < 0 || table_p.get_animation(anim_id_l).frame_count == 0)
+		{
+			return;
+		}
+		BakedAnimation const &baked_l = table_p.get_animation(anim_id_l);
+		// back in view : catch up with the animation clock
+		if(animation_l.culled)
+		{
+			bool loop_l = animation_l.next_animation.is_empty() && !instance_l.dyn_animation.is_valid();
+			catch_up_animation(animation_l, table_p, baked_l, _elapsedAllTime, loop_l);
+			animation_l.culled = false;
+			command_p.schedule = true;
+		}
+
+		Vector2 pos_l = get_draw_pos(instance_l.pos_idx.get()) * _scale;
+		// current animation may have changed for a shorter one (direction)
+		int frame_id_l = baked_l.first_frame + std::min(animation_l.frame_idx, baked_l.frame_count - 1);
+		BakedFrame const *frame_l = &table_p.get_frame(frame_id_l);
+		animation_l.drawn_frame = frame_id_l;
+
+		// skip submission if nothing changed since last draw
+		if(animation_l.drawn
+		&& animation_l.drawn_texture == frame_l->texture.ptr()
+		&& animation_l.drawn_pos == pos_l
+		&& animation_l.drawn_offset == animation_l.offset)
+		{
+			command_p.skipped = true;
+			return;
+		}
+		animation_l.drawn = true;
+		animation_l.drawn_texture = frame_l->texture.ptr();
+		animation_l.drawn_pos = pos_l;
+		animation_l.drawn_offset = animation_l.offset;
+
+		command_p.frame = frame_l;
+		command_p.pos = pos_l;
 	}
 
-	int EntityDrawer::index_from_texture(Vector2 const &pos_p) const
+	void EntityDrawer::submit_draw_command(DrawCommand const &command_p)
 	{
-		return index_from_texture_with_tolerance(pos_p, 0);
+		EntityInstance &instance_l = _instances.get(command_p.idx);
+		AnimationInstance & animation_l = instance_l.animation.get();
+		Ref<Texture2D> const &texture_l = command_p.frame->texture;
+		Vector2 const &pos_l = command_p.pos;
+
+		// draw animaton
+		if(_batched)
+		{
+			draw_batched(animation_l, command_p.frame, pos_l);
+		}
+		else
+		{
+			RenderingServer::get_singleton()->canvas_item_set_transform(animation_l.info.rid, Transform2D(0., pos_l));
+			RenderingServer::get_singleton()->canvas_item_clear(animation_l.info.rid);
+		}
+
+		// required when empty texture in sprite frame
+		if(texture_l.is_valid())
+		{
+			// classic rendering
+			if(!_batched)
+			{
+				texture_l->draw(animation_l.info.rid, animation_l.offset, instance_l.instance_data);
+			}
+			// alternate rendering
+			if(instance_l.alt_info.is_valid()
+			&& instance_l.alt_info.get().rid.is_valid())
+			{
+				RenderingInfo &alt_info_l = instance_l.alt_info.get();
+				RenderingServer::get_singleton()->canvas_item_set_transform(alt_info_l.rid, Transform2D(0., pos_l));
+				RenderingServer::get_singleton()->canvas_item_clear(alt_info_l.rid);
+				// the index is given as the vertex color (no material per instance)
+				texture_l->draw(alt_info_l.rid, animation_l.offset, color_from_idx(command_p.idx));
+			}
+		}
 	}
 
-	int EntityDrawer::index_from_texture_with_tolerance(Vector2 const &pos_p, int tolerance_p) const
+	void EntityDrawer::hide_draw_command(DrawCommand const &command_p)
 	{
-		if(!_texture_catcher)
+		EntityInstance &instance_l = _instances.get(command_p.idx);
+		AnimationInstance & animation_l = instance_l.animation.get();
+		if(_batched)
 		{
-			return -1;
+			release_batch_slot(animation_l);
 		}
-		// scale from texture viewport scale
-		double scale_l = _texture_catcher->get_scale_viewport();
-		Vector2 scale_pos_l = pos_p / scale_l;
+		else if(animation_l.info.rid.is_valid())
+		{
+			RenderingServer::get_singleton()->canvas_item_clear(animation_l.info.rid);
+		}
+		if(instance_l.alt_info.is_valid()
+		&& instance_l.alt_info.get().rid.is_valid())
+		{
+			RenderingServer::get_singleton()->canvas_item_clear(instance_l.alt_info.get().rid);
+		}
+	}
 
-		Ref<Image> image_l = _texture_catcher->get_texture()->get_image();
-		int idx_l = idx_from_color(safe_color(scale_pos_l.x, scale_pos_l.y, image_l));
-		if(idx_l >= 0)
+	void EntityDrawer::run_parallel(void (*func_p)(void *, uint32_t), size_t count_p, String const &description_p)
+	{
+		if(!_parallel || count_p < _parallel_threshold)
 		{
-			return idx_l;
+			for(size_t i = 0 ; i < count_p ; ++ i)
+			{
+				func_p(this, uint32_t(i));
+			}
+			return;
 		}
-		for(size_t range_l = 1; range_l < tolerance_p; ++ range_l)
+		WorkerThreadPool *pool_l = WorkerThreadPool::get_singleton();
+		auto task_l = pool_l->add_native_group_task(func_p, this, int(count_p), -1, true, description_p);
+		pool_l->wait_for_group_task_completion(task_l);
+	}
+
+	void EntityDrawer::_draw()
+	{
+		std::lock_guard<std::mutex> lock_l(_mutex);
+		BakedFramesTable const &table_l = frames_table();
+		_skipped_draw_count = 0;
+		update_visible_positions();
+		// interpolate all positions in one sweep
+		if(_jitter_buffer_size == 0
+		|| !_history.sample(_sim_clock - _render_delay, _max_extrapolation, _drawPos))
 		{
-			for(size_t x = 0 ; x <= range_l ; ++x)
+			interpolate_positions(_oldPos, _newPos, std::min<float>(1.f, float(_elapsedTime/_timeStep)), _drawPos);
+		}
+
+		// advance frames
+		update_animation_timers(table_l);
+
+		// compute draw commands grouped by component mask
+		update_mask_groups();
+		_draw_commands.clear();
+		for(int mask_l = 0 ; mask_l < COMPONENT_MASK_COUNT ; ++ mask_l)
+		{
+			_mask_group_commands[mask_l] = _draw_commands.size();
+			for(int idx_l : _mask_groups[mask_l])
 			{
-				for(size_t y = 0 ; y <= range_l ; ++y)
-				{
-					if(x+y == 0 || x+y > range_l) { continue; }
-					idx_l = idx_from_color(safe_color(scale_pos_l.x+x, scale_pos_l.y+y, image_l));
-					if(idx_l >= 0) { return idx_l; }
-					idx_l = idx_from_color(safe_color(scale_pos_l.x-x, scale_pos_l.y+y, image_l));
-					if(idx_l >= 0) { return idx_l; }
-					idx_l = idx_from_color(safe_color(scale_pos_l.x-x, scale_pos_l.y-y, image_l));
-					if(idx_l >= 0) { return idx_l; }
-					idx_l = idx_from_color(safe_color(scale_pos_l.x+x, scale_pos_l.y-y, image_l));
-					if(idx_l >= 0) { return idx_l; }
-				}
+				DrawCommand command_l;
+				command_l.idx = idx_l;
+				_draw_commands.push_back(command_l);
 			}
 		}
-		return -1;
+		_mask_group_commands[COMPONENT_MASK_COUNT] = _draw_commands.size();
+
+		// one specialized loop per component mask
+		static void (* const prepare_tasks_l[COMPONENT_MASK_COUNT])(void *, uint32_t) = {
+			&EntityDrawer::prepare_draw_command_task<0>,
+			&EntityDrawer::prepare_draw_command_task<1>,
+			&EntityDrawer::prepare_draw_command_task<2>,
+			&EntityDrawer::prepare_draw_command_task<3>,
+			&EntityDrawer::prepare_draw_command_task<4>,
+			&EntityDrawer::prepare_draw_command_task<5>,
+			&EntityDrawer::prepare_draw_command_task<6>,
+			&EntityDrawer::prepare_draw_command_task<7>,
+		};
+		for(int mask_l = 0 ; mask_l < COMPONENT_MASK_COUNT ; ++ mask_l)
+		{
+			_mask_group_offset = _mask_group_commands[mask_l];
+			run_parallel(prepare_tasks_l[mask_l], _mask_group_commands[mask_l + 1] - _mask_group_offset, "EntityDrawer::prepare_draw_command");
+		}
+
+		// submit draw commands
+		bool picking_dirty_l = false;
+		for(size_t i = 0 ; i < _draw_commands.size() ; ++ i)
+		{
+			DrawCommand const &command_l = _draw_commands[i];
+			if((command_l.frame || command_l.hide) && i >= _mask_group_commands[COMPONENT_PICKABLE])
+			{
+				picking_dirty_l = true;
+			}
+			if(command_l.schedule)
+			{
+				schedule_animation(command_l.idx, _instances.get(command_l.idx), table_l);
+			}
+			if(command_l.skipped)
+			{
+				++_skipped_draw_count;
+			}
+			if(command_l.frame)
+			{
+				submit_draw_command(command_l);
+			}
+			if(command_l.hide)
+			{
+				hide_draw_command(command_l);
+			}
+		}
+
+		flush_deferred_frees();
+
+		// pickable entities changed : cached picking render is outdated
+		if(_texture_catcher && (picking_dirty_l || _picking_changed.exchange(false)))
+		{
+			_texture_catcher->mark_dirty();
+		}
+
+		// upload batches
+		for(std::unique_ptr<MultiMeshBatch> &batch_l : _batches)
+		{
+			batch_l->flush();
+		}
 	}
-	void EntityDrawer::_notification(int p_notification)
+
+	void EntityDrawer::update_mask_groups()
 	{
-		switch (p_notification) {
-			case NOTIFICATION_PROCESS: {
-				_process(get_process_delta_time());
-			} break;
-			case NOTIFICATION_PHYSICS_PROCESS: {
-				_physics_process(get_physics_process_delta_time());
-			} break;
-			case NOTIFICATION_DRAW: {
-				_draw();
-			} break;
-			case NOTIFICATION_READY: {
-				_ready();
-				set_process(true);
-				set_physics_process(true);
-			} break;
+		if(!_mask_groups_dirty.exchange(false))
+		{
+			return;
+		}
+		for(std::vector<int> &mask_l : _mask_groups)
+		{
+			mask_l.clear();
 		}
+		_instances.for_each([&](EntityInstance &instance_p, size_t idx_p) {
+			if(instance_p.animation.is_valid())
+			{
+				_mask_groups[instance_p.components].push_back(int(idx_p));
+			}
+		});
 	}
 
-	void EntityDrawer::_ready()
+	void EntityDrawer::set_component(EntityInstance &instance_p, int component_p, bool present_p)
 	{
-		// Custom shader to display a color per idx
-		_alt_shader = Ref<Shader>(memnew(Shader));
-		_alt_shader->set_code("\n\
-			shader_type canvas_item;\n\
-			\n\
-			uniform vec3 idx_color : source_color = vec3(1.0);\n\
-			\n\
-			void fragment() {\n\
-				COLOR.rgb = idx_color;\n\
-				COLOR.a = round(COLOR.a);\n\
-			}\n\
-			"
-		);
+		if(present_p)
+		{
+			instance_p.components |= uint8_t(component_p);
+		}
+		else
+		{
+			instance_p.components &= uint8_t(~component_p);
+		}
+		_mask_groups_dirty = true;
+	}
 
-		_texture_catcher = memnew(TextureCatcher);
-		_texture_catcher->set_scale_viewport(_scale_viewport);
-		if(!_ref_camera_path.is_empty())
+	void EntityDrawer::flush_deferred_frees()
+	{
+		if(_deferred_frees.empty())
 		{
-			_texture_catcher->set_ref_camera("../"+_ref_camera_path);
+			return;
 		}
-		add_child(_texture_catcher);
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+		for(smart_list_handle<EntityInstance> const &handle_l : _deferred_frees)
+		{
+			// may have been freed in the meantime
+			if(handle_l.is_valid())
+			{
+				free_instance_internal(int(handle_l.handle()), false);
+			}
+		}
+		_deferred_frees.clear();
+		clear_released_rids();
 	}
 
-	StringName const &get_anim(EntityInstance &instance_p)
+	void EntityDrawer::clear_released_rids()
 	{
-		if(!instance_p.dir_handler.is_valid())
+		if(!_released_rids.empty())
 		{
-			return instance_p.animation.get().current_animation;
+			_picking_changed = true;
 		}
-		DirectionHandler const &handler_l = instance_p.dir_handler.get();
-		int type_l = handler_l.type;
-		if(type_l == DirectionHandler::NONE)
+		RenderingServer *rs_l = RenderingServer::get_singleton();
+		for(RID const &rid_l : _released_rids)
 		{
-			type_l = DirectionHandler::LEFT;
+			rs_l->canvas_item_clear(rid_l);
 		}
+		_released_rids.clear();
+	}
 
-		// forced directionl anim
-		if(instance_p.dir_animation.is_valid()
-		&& instance_p.dir_animation.get().base_name != StringName("")
-		&& instance_p.animation.get().has_priority)
+	int EntityDrawer::get_batch(RID const &texture_p, int z_index_p)
+	{
+		std::pair<int64_t, int> key_l(texture_p.get_id(), z_index_p);
+		auto it_l = _batch_indexes.find(key_l);
+		if(it_l != _batch_indexes.end())
 		{
-			return instance_p.dir_animation.get().names[type_l];
+			return it_l->second;
 		}
 
-		if(instance_p.dyn_animation.is_valid()
-		&& instance_p.dir_handler.is_valid())
+		// lazy set up of shared resources
+		if(!_batch_mesh.is_valid())
 		{
-			if(handler_l.idle)
+			PackedVector2Array vertices_l;
+			vertices_l.push_back(Vector2(0, 0));
+			vertices_l.push_back(Vector2(1, 0));
+			vertices_l.push_back(Vector2(1, 1));
+			vertices_l.push_back(Vector2(0, 1));
+			PackedInt32Array indexes_l;
+			for(int idx_l : {0, 1, 2, 0, 2, 3})
 			{
-				// non-forced directionl anim
-				if(instance_p.dir_animation.is_valid()
-				&& instance_p.dir_animation.get().base_name != StringName(""))
-				{
-					return instance_p.dir_animation.get().names[type_l];
-				}
-				return instance_p.dyn_animation.get().idle.names[type_l];
+				indexes_l.push_back(idx_l);
 			}
-			return instance_p.dyn_animation.get().moving.names[type_l];
+			Array arrays_l;
+			arrays_l.resize(RenderingServer::ARRAY_MAX);
+			arrays_l[RenderingServer::ARRAY_VERTEX] = vertices_l;
+			arrays_l[RenderingServer::ARRAY_TEX_UV] = vertices_l;
+			arrays_l[RenderingServer::ARRAY_INDEX] = indexes_l;
+
+			_batch_mesh = RenderingServer::get_singleton()->mesh_create();
+			RenderingServer::get_singleton()->mesh_add_surface_from_arrays(_batch_mesh, RenderingServer::PRIMITIVE_TRIANGLES, arrays_l);
+		}
+		if(_batch_material.is_null())
+		{
+			// Custom shader to map the uv region of every instance (stored in custom data)
+			Ref<Shader> shader_l = Ref<Shader>(memnew(Shader));
+			shader_l->set_code("\n\
+				shader_type canvas_item;\n\
+				\n\
+				void vertex() {\n\
+					UV = INSTANCE_CUSTOM.xy + UV * INSTANCE_CUSTOM.zw;\n\
+				}\n\
+				"
+			);
+			_batch_material = Ref<ShaderMaterial>(memnew(ShaderMaterial));
+			_batch_material->set_shader(shader_l);
 		}
-		return instance_p.animation.get().current_animation;
+
+		int idx_l = int(_batches.size());
+		_batches.emplace_back(new MultiMeshBatch(texture_p, z_index_p, get_canvas_item(), _batch_mesh, _batch_material->get_rid()));
+		_batch_indexes[key_l] = idx_l;
+		return idx_l;
 	}
 
-	void EntityDrawer::_draw()
+	void EntityDrawer::draw_batched(AnimationInstance &animation_p, BakedFrame const *frame_p, Vector2 const &pos_p)
 	{
-		std::lock_guard<std::mutex> lock_l(_mutex);
+		// required when empty texture in sprite frame
+		if(!frame_p || frame_p->texture.is_null())
+		{
+			release_batch_slot(animation_p);
+			return;
+		}
+		TextureRegion const &region_l = frame_p->region;
+		int batch_l = get_batch(region_l.texture, animation_p.z_index);
+		// texture changed to another atlas : change batch
+		if(batch_l != animation_p.batch)
+		{
+			release_batch_slot(animation_p);
+			animation_p.batch = batch_l;
+			animation_p.batch_slot = _batches[batch_l]->claim_slot();
+		}
+		_batches[batch_l]->set_slot(animation_p.batch_slot, pos_p + animation_p.offset + region_l.margin, region_l);
+	}
 
-		_instances.for_each([&](EntityInstance &instance_p, size_t idx_p) {
-			StringName cur_anim_l = get_anim(instance_p);
-			if(!instance_p.animation.is_valid())
-			{
-				return;
-			}
-			bool is_over_l = false;
-			AnimationInstance & animation_l = instance_p.animation.get();
-			if(animation_l.animation.is_valid() && animation_l.animation->get_frame_count(cur_anim_l) > 0)
-			{
-				double frameTime_l = animation_l.animation->get_frame_duration(cur_anim_l, animation_l.frame_idx) / animation_l.animation->get_animation_speed(cur_anim_l) ;
-				double nextFrameTime_l = animation_l.start + frameTime_l;
-				if(_elapsedAllTime >= nextFrameTime_l)
-				{
-					++animation_l.frame_idx;
-					animation_l.start = _elapsedAllTime;
-				}
-				if(animation_l.frame_idx >= animation_l.animation->get_frame_count(cur_anim_l))
-				{
-					if(animation_l.one_shot)
-					{
-						free_instance(idx_p);
-						is_over_l = true;
-					}
-					else if(animation_l.next_animation != StringName(""))
-					{
-						set_animation(idx_p, animation_l.next_animation, StringName(""));
-						cur_anim_l = get_anim(instance_p);
-					}
-					// if dynamic animation and no chaining we reset
-					else if(instance_p.dyn_animation.is_valid())
-					{
-						set_animation(idx_p, StringName(""), StringName(""));
-						cur_anim_l = get_anim(instance_p);
-					}
-					animation_l.frame_idx = 0;
-				}
-				// if still enabled
-				if(!is_over_l)
-				{
-					size_t pos_idx_l = instance_p.pos_idx.get().idx;
-					Vector2 diff_l = _newPos[pos_idx_l] - _oldPos[pos_idx_l];
-					Vector2 pos_l =  (_oldPos[pos_idx_l] + diff_l * std::min<real_t>(1., real_t(_elapsedTime/_timeStep))) * _scale;
-					// draw animaton
-					Ref<Texture2D> texture_l = animation_l.animation->get_frame_texture(cur_anim_l, animation_l.frame_idx);
-					RenderingServer::get_singleton()->canvas_item_set_transform(animation_l.info.rid, Transform2D(0., pos_l));
-					RenderingServer::get_singleton()->canvas_item_clear(animation_l.info.rid);
-
-					// required when empty texture in sprite frame
-					if(texture_l.is_valid())
-					{
-						// classic rendering
-						texture_l->draw(animation_l.info.rid, animation_l.offset);
-						// alternate rendering
-						if(instance_p.alt_info.is_valid()
-						&& instance_p.alt_info.get().rid.is_valid())
-						{
-							RenderingInfo &alt_info_l = instance_p.alt_info.get();
-							RenderingServer::get_singleton()->canvas_item_set_transform(alt_info_l.rid, Transform2D(0., pos_l));
-							RenderingServer::get_singleton()->canvas_item_clear(alt_info_l.rid);
-							texture_l->draw(alt_info_l.rid, animation_l.offset);
-						}
-					}
-				}
-			}
-		});
+	void EntityDrawer::warn_batched(char const *method_p) const
+	{
+		if(_batched && !_batched_warned)
+		{
+			_batched_warned = true;
+			WARN_PRINT(String(method_p) + " has no effect in batched mode (instances are drawn with the batch material only)");
+		}
+	}
+
+	void EntityDrawer::release_batch_slot(AnimationInstance &animation_p)
+	{
+		if(animation_p.batch >= 0)
+		{
+			_batches[animation_p.batch]->release_slot(animation_p.batch_slot);
+		}
+		animation_p.batch = -1;
+		animation_p.batch_slot = -1;
+	}
+
+	void EntityDrawer::push_command(EntityCommand &&command_p)
+	{
+		command_p.timestamp = std::chrono::steady_clock::now();
+		// commands are only applied by _process (never by the pushing thread)
+		_commands.push(std::move(command_p));
+	}
+
+	void EntityDrawer::drain_commands()
+	{
+		std::lock_guard<std::mutex> lock_l(_internal_mutex);
+
+		std::chrono::steady_clock::time_point now_l = std::chrono::steady_clock::now();
+		double total_latency_l = 0.;
+		double max_latency_l = 0.;
+		int count_l = 0;
+		EntityCommand command_l;
+		while(_commands.pop(command_l))
+		{
+			double latency_l = std::chrono::duration<double>(now_l - command_l.timestamp).count();
+			total_latency_l += latency_l;
+			max_latency_l = std::max(max_latency_l, latency_l);
+			++count_l;
+			apply_command(command_l);
+		}
+		clear_released_rids();
+
+		_command_queue_depth = count_l;
+		_command_queue_latency = count_l > 0 ? total_latency_l / count_l : 0.;
+		_command_queue_max_latency = max_latency_l;
+	}
+
+	void EntityDrawer::apply_command(EntityCommand const &command_p)
+	{
+		int idx_l = command_p.idx;
+		// instance may have been freed by a previous command
+		if(idx_l >= 0 && !_instances.is_valid(idx_l))
+		{
+			return;
+		}
+		switch(command_p.type)
+		{
+			case EntityCommand::FREE_INSTANCE:
+				free_instance_internal(idx_l, false);
+				break;
+			case EntityCommand::FREE_INSTANCES:
+				free_instances_internal(command_p.indexes);
+				break;
+			case EntityCommand::UPDATE_SPRITE_FRAMES:
+				update_sprite_frames_internal(idx_l, command_p.vector, command_p.frames);
+				break;
+			case EntityCommand::SET_DIRECTION:
+				set_direction_internal(idx_l, command_p.vector, command_p.flag);
+				break;
+			case EntityCommand::ADD_DIRECTION_HANDLER:
+				add_direction_handler_internal(idx_l, command_p.flag);
+				break;
+			case EntityCommand::REMOVE_DIRECTION_HANDLER:
+				remove_direction_handler_internal(idx_l);
+				break;
+			case EntityCommand::ADD_DYNAMIC_ANIMATION:
+				add_dynamic_animation_internal(idx_l, command_p.animation, command_p.next_animation);
+				break;
+			case EntityCommand::ADD_PICKABLE:
+				add_pickable_internal(idx_l);
+				break;
+			case EntityCommand::REMOVE_PICKABLE:
+				remove_pickable_internal(idx_l);
+				break;
+			case EntityCommand::SET_ANIMATION:
+				set_animation_internal(idx_l, command_p.animation, command_p.next_animation);
+				break;
+			case EntityCommand::SET_PRORITARY_ANIMATION:
+				set_proritary_animation_internal(idx_l, command_p.animation, command_p.next_animation);
+				break;
+			case EntityCommand::SET_ANIMATION_ONE_SHOT:
+				set_animation_one_shot_internal(idx_l, command_p.animation, command_p.flag);
+				break;
+			case EntityCommand::SET_NEW_POS:
+				set_new_pos_internal(idx_l, command_p.vector);
+				break;
+			case EntityCommand::SET_NEW_POS_BATCH:
+				set_new_pos_batch_internal(command_p.indexes, command_p.positions);
+				break;
+			case EntityCommand::SET_NEW_POS_DENSE:
+				set_new_pos_dense_internal(command_p.positions);
+				break;
+			case EntityCommand::UPDATE_POS:
+				update_pos_internal(command_p.time);
+				break;
+			case EntityCommand::COMPACT_POSITIONS:
+				compact_positions_internal();
+				break;
+		}
 	}
 
 	void EntityDrawer::_process(double delta_p)
 	{
-		std::lock_guard<std::mutex> lock_l(_mutex);
+		drain_commands();
+
+		if(_pool.is_reserve_pending() || _pickable_pool.is_reserve_pending())
+		{
+			std::lock_guard<std::mutex> lock_l(_internal_mutex);
+			process_reservation(_reserve_time_budget > 0.);
+		}
+		else if(_auto_shrink)
+		{
+			std::lock_guard<std::mutex> lock_l(_internal_mutex);
+			size_t shrunk_l = _pool.shrink(size_t(_pool_watermark), AUTO_SHRINK_COUNT);
+			_pickable_pool.shrink(size_t(_pool_watermark), AUTO_SHRINK_COUNT - shrunk_l);
+		}
+
+		// positions are compacted by the writer (update_pos), the signal is emitted here
+		if(_positions_compacted.exchange(false))
+		{
+			emit_signal("positions_compacted");
+		}
 
-		_elapsedTime += delta_p;
-		_elapsedAllTime += delta_p;
+		// signals are emitted without the lock (handlers may call the drawer)
+		std::vector<int> resolved_l;
+		{
+			std::lock_guard<std::mutex> lock_l(_mutex);
+
+			acquire_positions();
+			resolve_pick_requests(resolved_l);
+
+			_elapsedTime += delta_p;
+			_elapsedAllTime += delta_p;
+			_sim_clock += delta_p;
+		}
+		for(int ticket_l : resolved_l)
+		{
+			auto it_l = _pick_results.find(ticket_l);
+			if(it_l != _pick_results.end())
+			{
+				emit_signal("pick_ready", ticket_l, it_l->second.indexes);
+			}
+		}
 
 		queue_redraw();
 	}
@@ -831,9 +2914,10 @@ namespace godot
 
 		dir_handlers.for_each([&](DirectionHandler &handler_p) {
 			Vector2 dir_l = handler_p.direction;
-			if(dir_l.length_squared() < ENTITY_DRAWER_EPSILON)
+			// positions may not be published yet
+			if(dir_l.length_squared() < ENTITY_DRAWER_EPSILON && handler_p.pos_idx < _newPos.size())
 			{
-				dir_l = _newPos[handler_p.pos_idx] - _oldPos[handler_p.pos_idx];
+				dir_l = _newPos.get(handler_p.pos_idx) - _oldPos.get(handler_p.pos_idx);
 			}
 			int new_type = get_direction(dir_l, handler_p.has_up_down);
 			if(new_type != DirectionHandler::NONE)
@@ -874,9 +2958,11 @@ namespace godot
 	{
 		ClassDB::bind_method(D_METHOD("add_instance", "position", "offset", "animation", "current_animation", "next_animation", "one_shot", "in_front"), &EntityDrawer::add_instance);
 		ClassDB::bind_method(D_METHOD("add_sub_instance", "idx_ref", "offset", "animation", "current_animation", "next_animation", "one_shot", "in_front", "use_directions"), &EntityDrawer::add_sub_instance);
+		ClassDB::bind_method(D_METHOD("add_instances", "positions", "offset", "animation", "current_animation", "next_animation", "one_shot", "in_front"), &EntityDrawer::add_instances);
 		ClassDB::bind_method(D_METHOD("free_instance", "idx"), &EntityDrawer::free_instance);
+		ClassDB::bind_method(D_METHOD("free_instances", "indexes"), &EntityDrawer::free_instances);
 		ClassDB::bind_method(D_METHOD("update_sprite_frames", "idx", "offset", "animation"), &EntityDrawer::update_sprite_frames);
-		ClassDB::bind_method(D_METHOD("update_pos"), &EntityDrawer::update_pos);
+		ClassDB::bind_method(D_METHOD("update_pos", "sim_time"), &EntityDrawer::update_pos, DEFVAL(-1.));
 
 		ClassDB::bind_method(D_METHOD("set_animation", "instance", "current_animation", "next_animation"), &EntityDrawer::set_animation);
 		ClassDB::bind_method(D_METHOD("set_proritary_animation", "instance", "current_animation", "next_animation"), &EntityDrawer::set_proritary_animation);
@@ -889,7 +2975,19 @@ namespace godot
 		ClassDB::bind_method(D_METHOD("remove_pickable", "instance"), &EntityDrawer::remove_pickable);
 		ClassDB::bind_method(D_METHOD("set_new_pos", "instance", "pos"), &EntityDrawer::set_new_pos);
 		ClassDB::bind_method(D_METHOD("get_old_pos", "instance"), &EntityDrawer::get_old_pos);
+		ClassDB::bind_method(D_METHOD("get_pos_index", "instance"), &EntityDrawer::get_pos_index);
+		ClassDB::bind_method(D_METHOD("set_new_pos_batch", "instances", "positions"), &EntityDrawer::set_new_pos_batch);
+		ClassDB::bind_method(D_METHOD("set_new_pos_dense", "positions"), &EntityDrawer::set_new_pos_dense);
+		ClassDB::bind_method(D_METHOD("get_old_pos_batch", "instances"), &EntityDrawer::get_old_pos_batch);
+		ClassDB::bind_method(D_METHOD("get_old_pos_dense"), &EntityDrawer::get_old_pos_dense);
 		ClassDB::bind_method(D_METHOD("get_shader_material", "instance"), &EntityDrawer::get_shader_material);
+		ClassDB::bind_method(D_METHOD("set_instance_data", "instance", "data"), &EntityDrawer::set_instance_data);
+		ClassDB::bind_method(D_METHOD("get_instance_data", "instance"), &EntityDrawer::get_instance_data);
+		ClassDB::bind_method(D_METHOD("set_instance_data_channel", "channel", "values"), &EntityDrawer::set_instance_data_channel);
+		ClassDB::bind_method(D_METHOD("set_instance_data_flags", "channel", "values"), &EntityDrawer::set_instance_data_flags);
+		ClassDB::bind_method(D_METHOD("set_instance_data_from_indexes", "channel", "indexes", "value_index"), &EntityDrawer::set_instance_data_from_indexes);
+		ClassDB::bind_method(D_METHOD("set_all_instance_data_from_indexes", "channel", "indexes", "value_index", "value_other"), &EntityDrawer::set_all_instance_data_from_indexes);
+		ClassDB::bind_method(D_METHOD("map_shader_param", "param", "channel"), &EntityDrawer::map_shader_param);
 		ClassDB::bind_method(D_METHOD("set_shader_bool_param", "idx", "param", "value"), &EntityDrawer::set_shader_bool_param);
 		ClassDB::bind_method(D_METHOD("set_shader_bool_params", "param", "values"), &EntityDrawer::set_shader_bool_params);
 		ClassDB::bind_method(D_METHOD("set_shader_bool_params_from_indexes", "param", "indexes", "value_index"), &EntityDrawer::set_shader_bool_params_from_indexes);
@@ -897,9 +2995,11 @@ namespace godot
 		ClassDB::bind_method(D_METHOD("set_shader", "material"), &EntityDrawer::set_shader);
 
 		ClassDB::bind_method(D_METHOD("set_time_step", "time_step"), &EntityDrawer::set_time_step);
+		ClassDB::bind_method(D_METHOD("get_skipped_draw_count"), &EntityDrawer::get_skipped_draw_count);
 
 		ClassDB::bind_method(D_METHOD("indexes_from_texture", "rect"), &EntityDrawer::indexes_from_texture);
 		ClassDB::bind_method(D_METHOD("index_array_from_texture", "rect"), &EntityDrawer::index_array_from_texture);
+		ClassDB::bind_method(D_METHOD("packed_indexes_from_texture", "rect"), &EntityDrawer::packed_indexes_from_texture);
 		ClassDB::bind_method(D_METHOD("index_from_texture", "position"), &EntityDrawer::index_from_texture);
 		ClassDB::bind_method(D_METHOD("index_from_texture_with_tolerance", "position", "tolerance"), &EntityDrawer::index_from_texture_with_tolerance);
 
@@ -912,10 +3012,103 @@ namespace godot
 		ClassDB::bind_method(D_METHOD("set_ref_camera", "ref_camera"), &EntityDrawer::set_ref_camera);
 		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::NODE_PATH, "ref_camera", PROPERTY_HINT_NODE_PATH_VALID_TYPES, "Camera2D"), "set_ref_camera", "get_ref_camera");
 
+		ClassDB::bind_method(D_METHOD("get_frames_library"), &EntityDrawer::get_frames_library);
+		ClassDB::bind_method(D_METHOD("set_frames_library", "frames_library"), &EntityDrawer::set_frames_library);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::NODE_PATH, "frames_library", PROPERTY_HINT_NODE_PATH_VALID_TYPES, "FramesLibrary"), "set_frames_library", "get_frames_library");
+
+		ClassDB::bind_method(D_METHOD("set_culling", "culling"), &EntityDrawer::set_culling);
+		ClassDB::bind_method(D_METHOD("is_culling"), &EntityDrawer::is_culling);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::BOOL, "culling"), "set_culling", "is_culling");
+
+		ClassDB::bind_method(D_METHOD("set_culling_margin", "culling_margin"), &EntityDrawer::set_culling_margin);
+		ClassDB::bind_method(D_METHOD("get_culling_margin"), &EntityDrawer::get_culling_margin);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::FLOAT, "culling_margin"), "set_culling_margin", "get_culling_margin");
+
+		ClassDB::bind_method(D_METHOD("set_culling_cell_size", "culling_cell_size"), &EntityDrawer::set_culling_cell_size);
+		ClassDB::bind_method(D_METHOD("get_culling_cell_size"), &EntityDrawer::get_culling_cell_size);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::FLOAT, "culling_cell_size"), "set_culling_cell_size", "get_culling_cell_size");
+
+		ClassDB::bind_method(D_METHOD("set_picking_mode", "picking_mode"), &EntityDrawer::set_picking_mode);
+		ClassDB::bind_method(D_METHOD("get_picking_mode"), &EntityDrawer::get_picking_mode);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::INT, "picking_mode", PROPERTY_HINT_ENUM, "Texture,CPU"), "set_picking_mode", "get_picking_mode");
+		ClassDB::bind_method(D_METHOD("set_picking_on_demand", "picking_on_demand"), &EntityDrawer::set_picking_on_demand);
+		ClassDB::bind_method(D_METHOD("is_picking_on_demand"), &EntityDrawer::is_picking_on_demand);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::BOOL, "picking_on_demand"), "set_picking_on_demand", "is_picking_on_demand");
+		ClassDB::bind_method(D_METHOD("request_picking", "rect"), &EntityDrawer::request_picking);
+		ClassDB::bind_method(D_METHOD("request_pick", "position", "tolerance"), &EntityDrawer::request_pick);
+		ClassDB::bind_method(D_METHOD("request_pick_rect", "rect"), &EntityDrawer::request_pick_rect);
+		ClassDB::bind_method(D_METHOD("is_pick_ready", "ticket"), &EntityDrawer::is_pick_ready);
+		ClassDB::bind_method(D_METHOD("get_pick_result", "ticket"), &EntityDrawer::get_pick_result);
+		ADD_SIGNAL(MethodInfo("pick_ready", PropertyInfo(Variant::INT, "ticket"), PropertyInfo(Variant::PACKED_INT32_ARRAY, "indexes")));
+		ClassDB::bind_method(D_METHOD("set_picking_margin", "picking_margin"), &EntityDrawer::set_picking_margin);
+		ClassDB::bind_method(D_METHOD("get_picking_margin"), &EntityDrawer::get_picking_margin);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::FLOAT, "picking_margin"), "set_picking_margin", "get_picking_margin");
+
+		ClassDB::bind_method(D_METHOD("set_jitter_buffer_size", "jitter_buffer_size"), &EntityDrawer::set_jitter_buffer_size);
+		ClassDB::bind_method(D_METHOD("get_jitter_buffer_size"), &EntityDrawer::get_jitter_buffer_size);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::INT, "jitter_buffer_size"), "set_jitter_buffer_size", "get_jitter_buffer_size");
+		ClassDB::bind_method(D_METHOD("set_render_delay", "render_delay"), &EntityDrawer::set_render_delay);
+		ClassDB::bind_method(D_METHOD("get_render_delay"), &EntityDrawer::get_render_delay);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::FLOAT, "render_delay"), "set_render_delay", "get_render_delay");
+		ClassDB::bind_method(D_METHOD("set_max_extrapolation", "max_extrapolation"), &EntityDrawer::set_max_extrapolation);
+		ClassDB::bind_method(D_METHOD("get_max_extrapolation"), &EntityDrawer::get_max_extrapolation);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::FLOAT, "max_extrapolation"), "set_max_extrapolation", "get_max_extrapolation");
+
+		ClassDB::bind_method(D_METHOD("set_command_queue", "command_queue"), &EntityDrawer::set_command_queue);
+		ClassDB::bind_method(D_METHOD("is_command_queue"), &EntityDrawer::is_command_queue);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::BOOL, "command_queue"), "set_command_queue", "is_command_queue");
+		ClassDB::bind_method(D_METHOD("get_command_queue_depth"), &EntityDrawer::get_command_queue_depth);
+		ClassDB::bind_method(D_METHOD("get_command_queue_latency"), &EntityDrawer::get_command_queue_latency);
+		ClassDB::bind_method(D_METHOD("get_command_queue_max_latency"), &EntityDrawer::get_command_queue_max_latency);
+
+		ClassDB::bind_method(D_METHOD("reserve", "count", "pickable_count"), &EntityDrawer::reserve);
+		ClassDB::bind_method(D_METHOD("set_reserve_time_budget", "reserve_time_budget"), &EntityDrawer::set_reserve_time_budget);
+		ClassDB::bind_method(D_METHOD("get_reserve_time_budget"), &EntityDrawer::get_reserve_time_budget);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::FLOAT, "reserve_time_budget"), "set_reserve_time_budget", "get_reserve_time_budget");
+		ClassDB::bind_method(D_METHOD("get_pool_size"), &EntityDrawer::get_pool_size);
+		ClassDB::bind_method(D_METHOD("get_pool_high_water"), &EntityDrawer::get_pool_high_water);
+		ClassDB::bind_method(D_METHOD("get_pickable_pool_size"), &EntityDrawer::get_pickable_pool_size);
+		ClassDB::bind_method(D_METHOD("get_pickable_pool_high_water"), &EntityDrawer::get_pickable_pool_high_water);
+		ClassDB::bind_method(D_METHOD("set_pool_watermark", "pool_watermark"), &EntityDrawer::set_pool_watermark);
+		ClassDB::bind_method(D_METHOD("get_pool_watermark"), &EntityDrawer::get_pool_watermark);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::INT, "pool_watermark"), "set_pool_watermark", "get_pool_watermark");
+		ClassDB::bind_method(D_METHOD("set_auto_shrink", "auto_shrink"), &EntityDrawer::set_auto_shrink);
+		ClassDB::bind_method(D_METHOD("is_auto_shrink"), &EntityDrawer::is_auto_shrink);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::BOOL, "auto_shrink"), "set_auto_shrink", "is_auto_shrink");
+		ClassDB::bind_method(D_METHOD("shrink_to_fit"), &EntityDrawer::shrink_to_fit);
+		ClassDB::bind_method(D_METHOD("get_memory_usage"), &EntityDrawer::get_memory_usage);
+		ClassDB::bind_method(D_METHOD("get_fragmentation"), &EntityDrawer::get_fragmentation);
+		ClassDB::bind_method(D_METHOD("compact_positions"), &EntityDrawer::compact_positions);
+		ClassDB::bind_method(D_METHOD("set_compaction", "compaction"), &EntityDrawer::set_compaction);
+		ClassDB::bind_method(D_METHOD("is_compaction"), &EntityDrawer::is_compaction);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::BOOL, "compaction"), "set_compaction", "is_compaction");
+		ClassDB::bind_method(D_METHOD("set_compaction_threshold", "compaction_threshold"), &EntityDrawer::set_compaction_threshold);
+		ClassDB::bind_method(D_METHOD("get_compaction_threshold"), &EntityDrawer::get_compaction_threshold);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::FLOAT, "compaction_threshold"), "set_compaction_threshold", "get_compaction_threshold");
+		ClassDB::bind_method(D_METHOD("set_compaction_time_budget", "compaction_time_budget"), &EntityDrawer::set_compaction_time_budget);
+		ClassDB::bind_method(D_METHOD("get_compaction_time_budget"), &EntityDrawer::get_compaction_time_budget);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::FLOAT, "compaction_time_budget"), "set_compaction_time_budget", "get_compaction_time_budget");
+		ADD_SIGNAL(MethodInfo("positions_compacted"));
+
+		ClassDB::bind_method(D_METHOD("set_parallel", "parallel"), &EntityDrawer::set_parallel);
+		ClassDB::bind_method(D_METHOD("is_parallel"), &EntityDrawer::is_parallel);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::BOOL, "parallel"), "set_parallel", "is_parallel");
+
 		ClassDB::bind_method(D_METHOD("set_debug", "debug"), &EntityDrawer::set_debug);
 		ClassDB::bind_method(D_METHOD("is_debug"), &EntityDrawer::is_debug);
 		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::BOOL, "debug"), "set_debug", "is_debug");
 
+		ClassDB::bind_method(D_METHOD("_on_sprite_frames_changed", "frames"), &EntityDrawer::_on_sprite_frames_changed);
+		ClassDB::bind_method(D_METHOD("_on_picking_readback", "data"), &EntityDrawer::_on_picking_readback);
+
+		ClassDB::bind_method(D_METHOD("set_batched", "batched"), &EntityDrawer::set_batched);
+		ClassDB::bind_method(D_METHOD("is_batched"), &EntityDrawer::is_batched);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::BOOL, "batched"), "set_batched", "is_batched");
+
+		ClassDB::bind_method(D_METHOD("set_per_instance_material", "per_instance_material"), &EntityDrawer::set_per_instance_material);
+		ClassDB::bind_method(D_METHOD("is_per_instance_material"), &EntityDrawer::is_per_instance_material);
+		ClassDB::add_property("EntityDrawer", PropertyInfo(Variant::BOOL, "per_instance_material"), "set_per_instance_material", "is_per_instance_material");
+
 		ADD_GROUP("EntityDrawer", "EntityDrawer_");
 	}
 
@@ -929,6 +3122,28 @@ namespace godot
 		_payload_handler = payload_hanlder_p;
 	}
 
+	void EntityDrawer::set_batched(bool batched_p)
+	{
+		if(_instances.size() > 0)
+		{
+			return;
+		}
+		_batched = batched_p;
+		if(_shader.is_valid())
+		{
+			warn_batched("set_shader");
+		}
+	}
+
+	void EntityDrawer::set_per_instance_material(bool per_instance_material_p)
+	{
+		if(_instances.size() > 0)
+		{
+			return;
+		}
+		_per_instance_material = per_instance_material_p;
+	}
+
 	void EntityDrawer::set_debug(bool debug_p) { if(_texture_catcher) _texture_catcher->set_debug(debug_p); }
 	bool EntityDrawer::is_debug() const { if(_texture_catcher) return _texture_catcher->is_debug(); else return false; }
 
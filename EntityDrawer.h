@@ -6,6 +6,8 @@
 	#include <godot_cpp/classes/atlas_texture.hpp>
 	#include <godot_cpp/classes/shader_material.hpp>
 	#include <godot_cpp/classes/sprite_frames.hpp>
+	#include <godot_cpp/variant/packed_int32_array.hpp>
+	#include <godot_cpp/variant/packed_vector2_array.hpp>
 #else
 	#include "scene/2d/node_2d.h"
 	#include "scene/resources/atlas_texture.h"
@@ -13,11 +15,28 @@
 	#include "scene/resources/sprite_frames.h"
 #endif
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "smart_list/smart_list.h"
+#include "CanvasItemPool.h"
+#include "CommandQueue.h"
 #include "EntityPayload.h"
+#include "FramesLibrary.h"
+#include "MultiMeshBatch.h"
+#include "PickingBuffer.h"
+#include "PositionBuffer.h"
+#include "PositionSnapshots.h"
+#include "SmallVector.h"
+#include "SpatialGrid.h"
+#include "TimerWheel.h"
 
 namespace godot {
 
@@ -25,24 +44,30 @@ class TextureCatcher;
 
 struct PositionIndex
 {
-	size_t idx = 999999999;
+	uint32_t idx = 999999999;
+	/// @brief first position snapshot containing this position
+	uint64_t birth_tick = 0;
+	/// @brief position at creation (used until published)
+	Vector2 spawn;
 };
 
 struct RenderingInfo
 {
 	RID rid;
-	Ref<ShaderMaterial> material;
 };
 
 struct AnimationInstance
 {
 	/// @brief offset to apply to the texture to display it
 	Vector2 offset;
-	Ref<SpriteFrames> animation;
+	/// @brief id of the sprite frames in the baked table (keeping them alive)
+	int frames_id = -1;
 	bool enabled = true;
 	double start = 0.;
 	int frame_idx = 0;
 	StringName current_animation;
+	/// @brief id of the current animation in the baked table (-1 if none)
+	int current_id = -1;
 	StringName next_animation;
 	/// @brief will be destroyed after the end of the animation
 	bool one_shot = false;
@@ -50,12 +75,35 @@ struct AnimationInstance
 	RenderingInfo info;
 	/// @brief has priority on dynamic anim (of false will only be displayed if idle)
 	bool has_priority = false;
+
+	/// @brief z index used for rendering
+	int z_index = 0;
+	/// @brief batch and slot used in batched mode (-1 if none)
+	int batch = -1;
+	int batch_slot = -1;
+
+	/// @brief true if the animation was not updated because out of camera
+	bool culled = false;
+	/// @brief stamp of the last timer scheduled for the next frame (0 if none)
+	uint64_t timer_stamp = 0;
+
+	/// @brief last state submitted to the rendering server
+	/// used to skip the submission when nothing changed
+	bool drawn = false;
+	Texture2D const * drawn_texture = nullptr;
+	Vector2 drawn_pos;
+	Vector2 drawn_offset;
+	/// @brief id of the frame drawn in the baked table (-1 if not drawn)
+	int drawn_frame = -1;
+
+	/// @brief true if the instance is waiting in the deferred destruction queue
+	bool freeing = false;
 };
 
 struct DirectionalAnimation
 {
-	/// @brief directed names
-	std::array<StringName, 4> names;
+	/// @brief ids of the directed animations in the baked table
+	DirectionalIds ids = {-1, -1, -1, -1};
 	/// @brief base name
 	StringName base_name;
 };
@@ -72,7 +120,7 @@ struct DirectionHandler
 	/// @brief can use top down?
 	bool has_up_down = true;
 	/// @brief position index to be used
-	size_t pos_idx = 0;
+	uint32_t pos_idx = 0;
 
 	// dynamic data
 	Vector2 direction;
@@ -94,6 +142,70 @@ struct DynamicAnimation
 	DirectionalAnimation moving;
 };
 
+/// @brief result of a draw preparation
+/// computed in parallel and submitted to the rendering server afterwards
+struct DrawCommand
+{
+	/// @brief index of the instance
+	int idx = -1;
+	/// @brief frame to draw (nullptr if nothing to submit)
+	BakedFrame const *frame = nullptr;
+	Vector2 pos;
+	/// @brief true if the animation must be rescheduled (back in view)
+	bool schedule = false;
+	/// @brief true if the submission was skipped because nothing changed
+	bool skipped = false;
+	/// @brief true if the instance just went out of camera and its last frame must be cleared
+	bool hide = false;
+};
+
+/// @brief mutation of the drawer queued by a simulation thread
+/// applied at the beginning of the next process
+struct EntityCommand
+{
+	enum Type : char
+	{
+		FREE_INSTANCE,
+		FREE_INSTANCES,
+		UPDATE_SPRITE_FRAMES,
+		SET_DIRECTION,
+		ADD_DIRECTION_HANDLER,
+		REMOVE_DIRECTION_HANDLER,
+		ADD_DYNAMIC_ANIMATION,
+		ADD_PICKABLE,
+		REMOVE_PICKABLE,
+		SET_ANIMATION,
+		SET_PRORITARY_ANIMATION,
+		SET_ANIMATION_ONE_SHOT,
+		SET_NEW_POS,
+		SET_NEW_POS_BATCH,
+		SET_NEW_POS_DENSE,
+		UPDATE_POS,
+		COMPACT_POSITIONS
+	};
+
+	EntityCommand() = default;
+	EntityCommand(Type type_p, int idx_p) : type(type_p), idx(idx_p) {}
+
+	Type type = UPDATE_POS;
+	/// @brief index of the instance (-1 if none)
+	int idx = -1;
+
+	// arguments (depending on the type)
+	Vector2 vector;
+	bool flag = false;
+	StringName animation;
+	StringName next_animation;
+	Ref<SpriteFrames> frames;
+	/// @brief simulation time of update_pos
+	double time = 0.;
+	PackedInt32Array indexes;
+	PackedVector2Array positions;
+
+	/// @brief time of the push (to measure latency)
+	std::chrono::steady_clock::time_point timestamp;
+};
+
 struct EntityInstance
 {
 	/////
@@ -120,9 +232,16 @@ struct EntityInstance
 	/////
 	smart_list_handle<RenderingInfo> alt_info;
 
+	/// @brief per instance data given to the shader (as the vertex COLOR)
+	Color instance_data = Color(1, 1, 1, 1);
+
 	// relation links
-	std::list<smart_list_handle<EntityInstance> > sub_instances;
+	/// @brief handles of the sub instances (inline, no allocation for up to two)
+	SmallVector<smart_list_handle<EntityInstance>, 2> sub_instances;
 	smart_list_handle<EntityInstance> main_instance;
+
+	/// @brief components present (see EntityDrawer::COMPONENT_*)
+	uint8_t components = 0;
 };
 
 class EntityDrawer : public Node2D {
@@ -139,6 +258,12 @@ public:
 					bool one_shot_p, bool in_front_p, bool use_directions_p);
 	void free_instance(int idx_p, bool skip_main_free_p=false);
 
+	// batch creation/destruction (lock only once)
+	/// @brief canvas items are acquired from the pool in one pass before the instances are created
+	PackedInt32Array add_instances(PackedVector2Array const &positions_p, Vector2 const &offset_p, Ref<SpriteFrames> const & animation_p,
+		StringName const &current_animation_p, StringName const &next_animation_p, bool one_shot_p, bool in_front_p);
+	void free_instances(PackedInt32Array const &indexes_p);
+
 	// update animation of the instance
 	void update_sprite_frames(int idx_p, Vector2 const &offset_p, Ref<SpriteFrames> const & animation_p);
 
@@ -161,12 +286,45 @@ public:
 	StringName const & get_animation(int idx_p) const;
 
 	// position handling
+	/// positions are written by a single thread : the one adding and freeing instances
+	/// (unless command_queue is enabled)
 	void set_new_pos(int idx_p, Vector2 const &pos_p);
-	Vector2 const & get_old_pos(int idx_p);
-	void update_pos();
+	Vector2 get_old_pos(int idx_p);
+	/// @brief publish the positions set since the last call
+	/// sim_time_p is the simulation time of the positions (tick * time step) used by the
+	/// jitter buffer, a negative time stamps them with the local time of the call
+	void update_pos(double sim_time_p);
+
+	// bulk position handling
+	/// @brief index of the instance in the dense position arrays
+	/// (changes when positions are compacted, see positions_compacted)
+	int get_pos_index(int idx_p) const;
+	void set_new_pos_batch(PackedInt32Array const &indexes_p, PackedVector2Array const &positions_p);
+	/// @brief positions must be laid out in position index order (see get_pos_index)
+	void set_new_pos_dense(PackedVector2Array const &positions_p);
+	PackedVector2Array get_old_pos_batch(PackedInt32Array const &indexes_p) const;
+	/// @brief positions laid out in position index order (see get_pos_index)
+	PackedVector2Array get_old_pos_dense() const;
 
 	// shader handling
+	/// @brief material of the instance with per_instance_material enabled
+	/// @deprecated otherwise all instances share the same material which is returned
 	Ref<ShaderMaterial> get_shader_material(int idx_p);
+	/// @brief per instance data : four channels passed to the shader as the vertex COLOR
+	/// (read it in vertex() and do not let it modulate the texture)
+	void set_instance_data(int idx_p, Color const &data_p);
+	Color get_instance_data(int idx_p) const;
+	/// @brief bulk setters of one channel, values are given per instance index
+	void set_instance_data_channel(int channel_p, PackedFloat32Array const &values_p);
+	/// @brief values different from 0 set the channel to 1
+	void set_instance_data_flags(int channel_p, PackedByteArray const &values_p);
+	void set_instance_data_from_indexes(int channel_p, PackedInt32Array const &indexes_p, float value_indexes_p);
+	void set_all_instance_data_from_indexes(int channel_p, PackedInt32Array const &indexes_p, float value_indexes_p, float value_others_p);
+	/// @brief map a shader bool parameter to a channel of the instance data
+	/// (unmapped parameters given to the set_shader_bool_param* methods are mapped
+	/// to the first free channel, the shader must read it from COLOR)
+	/// with per_instance_material the parameter is set on the material of the instance instead
+	void map_shader_param(String const &param_p, int channel_p);
 	void set_shader_bool_param(int idx_p, String const &param_p, bool value_p);
 	void set_shader_bool_params(String const &param_p, TypedArray<bool> const &values_p);
 	void set_shader_bool_params_from_indexes(String const &param_p, TypedArray<int> const &indexes_p, bool value_indexes_p);
@@ -175,6 +333,8 @@ public:
 	/// getters for alternative rendering
 	TypedArray<int> indexes_from_texture(Rect2 const &rect_p) const;
 	TypedArray<bool> index_array_from_texture(Rect2 const &rect_p) const;
+	/// @brief unique indexes picked in the rect
+	PackedInt32Array packed_indexes_from_texture(Rect2 const &rect_p) const;
 	int index_from_texture(Vector2 const &pos_p) const;
 	int index_from_texture_with_tolerance(Vector2 const &pos_p, int tolerance_p) const;
 
@@ -195,14 +355,146 @@ public:
 	void set_scale_viewport(double const &scale_viewport) { _scale_viewport = scale_viewport; }
 	NodePath const & get_ref_camera() const { return _ref_camera_path; }
 	void set_ref_camera(NodePath const &ref_camera) { _ref_camera_path = ref_camera; }
+	NodePath const & get_frames_library() const { return _frames_library_path; }
+	void set_frames_library(NodePath const &frames_library) { _frames_library_path = frames_library; }
 	void set_debug(bool debug_p);
 	bool is_debug() const;
+	/// @brief batched mode can only be changed before any instance is added
+	/// batched instances are drawn with the batch material : the user shader, the instance
+	/// data and the set_shader_* setters are ignored (a warning is printed when they are used)
+	void set_batched(bool batched_p);
+	bool is_batched() const { return _batched; }
+	/// @brief one material per instance for the set_shader_bool_param* methods (slower, one
+	/// material per canvas item) for shaders not reading the instance data from COLOR
+	void set_per_instance_material(bool per_instance_material_p);
+	bool is_per_instance_material() const { return _per_instance_material; }
+
+	/// @brief culling of entities out of the camera (using a spatial grid)
+	void set_culling(bool culling_p) { _culling = culling_p; }
+	bool is_culling() const { return _culling; }
+	void set_culling_margin(double margin_p) { _culling_margin = margin_p; }
+	double get_culling_margin() const { return _culling_margin; }
+	void set_culling_cell_size(double cell_size_p);
+	double get_culling_cell_size() const { return _grid.get_cell_size(); }
+
+	/// @brief optional components of an instance (bit mask) : instances are grouped by mask
+	/// to be drawn by loops specialized for the components (components stay in their pools)
+	static int const COMPONENT_DIRECTIONAL = 1;
+	static int const COMPONENT_DYNAMIC = 2;
+	static int const COMPONENT_PICKABLE = 4;
+	static int const COMPONENT_MASK_COUNT = 8;
+
+	/// @brief picking modes
+	/// texture : entities are rendered in a picking viewport read back on every query
+	/// cpu : alpha masks of the frames are tested on the cpu (no picking viewport),
+	/// must be set before ready
+	static int const PICKING_TEXTURE = 0;
+	static int const PICKING_CPU = 1;
+	void set_picking_mode(int picking_mode_p);
+	int get_picking_mode() const { return _picking_mode; }
+	/// @brief texture picking : the picking viewport is only rendered on request (see request_picking)
+	/// and kept until the camera or pickable entities change
+	void set_picking_on_demand(bool on_demand_p);
+	bool is_picking_on_demand() const { return _picking_on_demand; }
+	/// @brief request a render of the picking viewport for the rect (screen coordinates, full screen if empty)
+	/// queries use it from the next frame
+	void request_picking(Rect2 const &rect_p);
+	/// @brief asynchronous picking
+	/// the result is delivered in a later frame (with one read back for all requests)
+	/// through the pick_ready(ticket, indexes) signal or get_pick_result
+	/// @return the ticket of the request
+	int request_pick(Vector2 const &pos_p, int tolerance_p);
+	int request_pick_rect(Rect2 const &rect_p);
+	bool is_pick_ready(int ticket_p) const;
+	/// @brief result of the request (empty if not ready), the result is released
+	PackedInt32Array get_pick_result(int ticket_p);
+
+	/// @brief margin around queries to find entities in the grid (biggest frame extent)
+	void set_picking_margin(double margin_p) { _picking_margin = margin_p; }
+	double get_picking_margin() const { return _picking_margin; }
+
+	/// @brief number of position snapshots kept to interpolate at a delayed time (0 to disable)
+	/// when enabled positions are rendered render_delay seconds in the past of the simulation
+	/// clock (time given to update_pos), interpolated between the snapshots around that time
+	/// (instead of using the time step)
+	void set_jitter_buffer_size(int size_p);
+	int get_jitter_buffer_size() const { return _jitter_buffer_size; }
+	void set_render_delay(double delay_p) { _render_delay = delay_p; }
+	double get_render_delay() const { return _render_delay; }
+	/// @brief maximum time (in seconds) positions are extrapolated after the last snapshot
+	void set_max_extrapolation(double max_extrapolation_p) { _max_extrapolation = max_extrapolation_p; }
+	double get_max_extrapolation() const { return _max_extrapolation; }
+
+	/// @brief update animations and prepare draw commands using the worker thread pool
+	void set_parallel(bool parallel_p) { _parallel = parallel_p; }
+	bool is_parallel() const { return _parallel; }
+
+	/// @brief queue mutations (including positions) from any thread
+	/// instead of applying them immediately, they are applied at the beginning of the next process
+	/// (creation of instances is never queued)
+	void set_command_queue(bool command_queue_p) { _command_queue = command_queue_p; }
+	bool is_command_queue() const { return _command_queue; }
+	/// @brief number of commands applied during last process
+	int get_command_queue_depth() const { return _command_queue_depth; }
+	/// @brief average and max time (in seconds) spent in the queue by commands applied during last process
+	double get_command_queue_latency() const { return _command_queue_latency; }
+	double get_command_queue_max_latency() const { return _command_queue_max_latency; }
+
+	/// @brief create the canvas items of count_p instances and pickable_count_p
+	/// pickable instances ahead (at load time) to avoid hitches on spawns
+	/// creation is spread over several frames when reserve_time_budget is set
+	void reserve(int count_p, int pickable_count_p);
+	/// @brief time (in milliseconds) spent per frame creating reserved canvas items (0 to create them at once)
+	void set_reserve_time_budget(double budget_p) { _reserve_time_budget = budget_p; }
+	double get_reserve_time_budget() const { return _reserve_time_budget; }
+	/// @brief number of canvas items created and maximum number used at once
+	int get_pool_size() const { return int(_pool.get_created()); }
+	int get_pool_high_water() const { return int(_pool.get_high_water()); }
+	int get_pickable_pool_size() const { return int(_pickable_pool.get_created()); }
+	int get_pickable_pool_high_water() const { return int(_pickable_pool.get_high_water()); }
+	/// @brief number of idle canvas items kept by shrink_to_fit
+	void set_pool_watermark(int watermark_p) { _pool_watermark = std::max(watermark_p, 0); }
+	int get_pool_watermark() const { return _pool_watermark; }
+	/// @brief free idle canvas items above the watermark a few at a time every frame
+	void set_auto_shrink(bool auto_shrink_p) { _auto_shrink = auto_shrink_p; }
+	bool is_auto_shrink() const { return _auto_shrink; }
+	/// @brief free all idle canvas items above the watermark (in both layers)
+	void shrink_to_fit();
+
+	/// @brief estimation of the memory used (in bytes) per component list and buffer
+	Dictionary get_memory_usage() const;
+
+	/// @brief ratio of free slots in the position buffers and in the instance list
+	Dictionary get_fragmentation() const;
+	/// @brief move the last positions in the free slots and truncate the buffers
+	/// position indexes change (see get_pos_index), instance indexes do not
+	/// writer side call (like set_new_pos), queued with command_queue
+	/// compacts every free slot at once (not bounded by COMPACTION_MAX_SLOTS)
+	void compact_positions();
+	/// @brief compact positions on every update_pos within the time budget once the
+	/// fragmentation of the position buffers exceeds the threshold
+	/// every update_pos moves or drops at most COMPACTION_MAX_SLOTS slots, the remaining
+	/// ones are compacted by the next calls
+	void set_compaction(bool compaction_p) { _compaction = compaction_p; }
+	bool is_compaction() const { return _compaction; }
+	void set_compaction_threshold(double threshold_p) { _compaction_threshold = threshold_p; }
+	double get_compaction_threshold() const { return _compaction_threshold; }
+	/// @brief time (in milliseconds) spent per update_pos compacting positions
+	/// (checked every 64 moves, within the COMPACTION_MAX_SLOTS limit)
+	void set_compaction_time_budget(double budget_p) { _compaction_time_budget = budget_p; }
+	double get_compaction_time_budget() const { return _compaction_time_budget; }
+	/// @brief maximum number of slots moved or dropped by the compaction of one update_pos
+	static size_t const COMPACTION_MAX_SLOTS = 4096;
+
+	/// @brief number of entities which submission was skipped during last draw
+	/// because their visual state did not change
+	int get_skipped_draw_count() const { return _skipped_draw_count; }
 
 	/// Properties END
 
 	// set up
 	void set_time_step(double timeStep_p) { _timeStep = timeStep_p; }
-	void set_shader(Ref<Shader> const &shader_p) { _shader = shader_p; }
+	void set_shader(Ref<Shader> const &shader_p);
 
 	// payload setup (free old one)
 	void setup_payload(AbstractEntityPayload * payload_hanlder_p);
@@ -212,7 +504,190 @@ public:
 protected:
 	void _notification(int p_notification);
 private:
+	// internal creation/destruction (no lock)
+	/// @brief canvas item from the pool for a new animation (invalid in batched mode)
+	RID acquire_canvas_item();
+	/// @param rid_p canvas item acquired by the caller (invalid in batched mode)
+	int add_instance_internal(Vector2 const &pos_p, RID const &rid_p, Vector2 const &offset_p, int frames_id_p,
+		StringName const &current_animation_p, StringName const &next_animation_p, bool one_shot_p, bool in_front_p);
+	void free_instance_internal(int idx_p, bool skip_main_free_p);
+	void free_instances_internal(PackedInt32Array const &indexes_p);
+
+	// internal mutations (no lock)
+	void update_sprite_frames_internal(int idx_p, Vector2 const &offset_p, Ref<SpriteFrames> const & animation_p);
+	void set_direction_internal(int idx_p, Vector2 const &direction_p, bool just_looking_p);
+	void add_direction_handler_internal(int idx_p, bool has_up_down_p);
+	void remove_direction_handler_internal(int idx_p);
+	void add_dynamic_animation_internal(int idx_p, StringName const &idle_animation_p, StringName const &moving_animation_p);
+	void add_pickable_internal(int idx_p);
+	void remove_pickable_internal(int idx_p);
+	void set_animation_internal(int idx_p, StringName const &current_animation_p, StringName const &next_animation_p);
+	void set_proritary_animation_internal(int idx_p, StringName const &current_animation_p, StringName const &next_animation_p);
+	void set_animation_one_shot_internal(int idx_p, StringName const &current_animation_p, bool priority_p);
+	void set_new_pos_internal(int idx_p, Vector2 const &pos_p);
+	void set_new_pos_batch_internal(PackedInt32Array const &indexes_p, PackedVector2Array const &positions_p);
+	void set_new_pos_dense_internal(PackedVector2Array const &positions_p);
+	/// @brief compact positions if enabled then publish them (requires internal mutex)
+	void update_pos_internal(double sim_time_p);
+	/// @brief requires internal mutex
+	void compact_positions_internal();
+
+	// command queue
+	void push_command(EntityCommand &&command_p);
+	/// @brief apply all queued commands (under one lock), called by _process only
+	void drain_commands();
+	void apply_command(EntityCommand const &command_p);
+
+	/// @brief table of baked frames (from the frames library if any)
+	BakedFramesTable & frames_table() { return _frames_library ? _frames_library->get_baked_frames() : _baked_frames; }
+	BakedFramesTable const & frames_table() const { return _frames_library ? _frames_library->get_baked_frames() : _baked_frames; }
+	/// @brief bake the sprite frames and watch them to bake them again when they change
+	int bake_frames(Ref<SpriteFrames> const &frames_p);
+	/// @brief bake again the changed sprite frames and move the instances using them to the new bake
+	void _on_sprite_frames_changed(Ref<SpriteFrames> const &frames_p);
+
+	// cpu picking
+	/// @brief call func_p(idx, animation, frame, frame rect) for every pickable instance drawn near the rect
+	template<typename func_t>
+	void for_each_pickable(Rect2 const &rect_p, func_t &&func_p) const;
+	static bool hit_mask(BakedFrame const &frame_p, Rect2 const &frame_rect_p, Vector2 const &pos_p);
+	int index_from_masks(Vector2 const &pos_p, int tolerance_p) const;
+	PackedInt32Array indexes_from_masks(Rect2 const &rect_p) const;
+
+	/// @brief read back the picking texture (blocking)
+	void read_picking_buffer() const;
+	/// @brief start an asynchronous read back of the picking texture through the rendering device
+	/// @return false if not available (compatibility renderer has no rendering device)
+	bool request_picking_readback();
+	/// @brief called by the rendering device with the content of the picking texture
+	void _on_picking_readback(PackedByteArray const &data_p);
+	/// @brief use the last asynchronous read back received as the picking buffer
+	void apply_picking_readback();
+
+	// asynchronous picking
+	struct PickRequest
+	{
+		int ticket = 0;
+		bool is_rect = false;
+		Vector2 pos;
+		int tolerance = 0;
+		Rect2 rect;
+		/// @brief frame of the request
+		uint64_t frame = 0;
+		/// @brief version of the picking render required (on demand picking)
+		uint64_t version = 0;
+	};
+	struct PickResult
+	{
+		PackedInt32Array indexes;
+		uint64_t frame = 0;
+	};
+	int add_pick_request(PickRequest &request_p, Rect2 const &region_p);
+	/// @brief true if the picking buffer holds a render recent enough for the request
+	bool is_picking_buffer_ready(PickRequest const &request_p) const;
+	/// @brief resolve requests which render is available
+	/// tickets resolved are added to resolved_p to emit pick_ready once the lock is released
+	void resolve_pick_requests(std::vector<int> &resolved_p);
+
+	/// @brief acquire the last published positions (rendering side)
+	void acquire_positions();
+	/// @brief move the position indexes of the grid to the positions acquired (rendering side)
+	void update_grid();
+	/// @brief position to draw (spawn position if not published yet)
+	Vector2 get_draw_pos(PositionIndex const &pos_idx_p) const;
+
+	/// @brief flag visible position indexes from the camera rect
+	void update_visible_positions();
+	/// @brief positions not published yet are always visible (they are not in the grid)
+	bool is_visible_position(PositionIndex const &pos_idx_p) const
+	{
+		return pos_idx_p.birth_tick > _positions_tick
+			|| pos_idx_p.idx >= _visible_positions.size()
+			|| _visible_positions[pos_idx_p.idx];
+	}
+
+	/// @brief restart the animation of the instance without locking nor scheduling
+	void restart_animation(EntityInstance &instance_p, StringName const &current_animation_p, StringName const &next_animation_p);
+	/// @brief set the current animation and resolve its ids (and the directed ones)
+	void set_current_animation(EntityInstance &instance_p, StringName const &animation_p);
+	/// @brief resolve again all animation ids of the instance (when sprite frames changed)
+	void resolve_animation_ids(EntityInstance &instance_p);
+
+	// animation timers
+	enum AnimationUpdate : char
+	{
+		ANIMATION_NONE,
+		ANIMATION_SCHEDULE,
+		ANIMATION_RETRY,
+		ANIMATION_FREE
+	};
+	/// @brief schedule all requested animations and advance animations which frame is over
+	void update_animation_timers(BakedFramesTable const &table_p);
+	/// @brief schedule the end of the current frame of the animation
+	void schedule_animation(int idx_p, EntityInstance &instance_p, BakedFramesTable const &table_p);
+	/// @brief go to the next frame of the animation (thread safe for different instances)
+	AnimationUpdate advance_animation(EntityInstance &instance_p, BakedFramesTable const &table_p);
+	static void advance_animation_task(void *drawer_p, uint32_t i);
+
+	// draw commands
+	/// @brief compute what to draw for the instance (thread safe for different instances)
+	/// the instance must be of the given component mask
+	template<int mask_t>
+	void prepare_draw_command(DrawCommand &command_p, BakedFramesTable const &table_p);
+	template<int mask_t>
+	static void prepare_draw_command_task(void *drawer_p, uint32_t i);
+	void submit_draw_command(DrawCommand const &command_p);
+	/// @brief clear what was submitted for the instance (culled)
+	void hide_draw_command(DrawCommand const &command_p);
+
+	/// @brief run func_p for every index in [0, count_p[ using the worker thread pool if parallel
+	void run_parallel(void (*func_p)(void *, uint32_t), size_t count_p, String const &description_p);
+
+	// batched rendering helpers
+	int get_batch(RID const &texture_p, int z_index_p);
+	void draw_batched(AnimationInstance &animation_p, BakedFrame const *frame_p, Vector2 const &pos_p);
+	/// @brief warn once that a shader related method is ignored in batched mode
+	void warn_batched(char const *method_p) const;
+	void release_batch_slot(AnimationInstance &animation_p);
+
+	// deferred destruction
+	/// @brief free all instances queued during draw at once
+	void flush_deferred_frees();
+	/// @brief clear canvas items of freed instances (requires internal mutex)
+	void clear_released_rids();
+
 	Ref<Shader> _shader;
+	/// @brief canvas items of the instances and of the alternative rendering
+	CanvasItemPool _pool;
+	CanvasItemPool _pickable_pool;
+	double _reserve_time_budget = 0.;
+	int _pool_watermark = 0;
+	bool _auto_shrink = false;
+	/// @brief maximum number of canvas items freed per frame by the automatic shrink
+	static size_t const AUTO_SHRINK_COUNT = 256;
+	/// @brief create reserved canvas items (within the time budget if bounded_p)
+	/// requires internal mutex
+	/// @return true if all reserved canvas items are created
+	bool process_reservation(bool bounded_p);
+
+	/// @brief material shared by all instances (using _shader)
+	Ref<ShaderMaterial> _material;
+	/// @brief channel of the instance data per shader parameter
+	std::unordered_map<StringName, int, StringNameHasher> _param_channels;
+	/// @brief set a channel of the instance data (requires internal mutex)
+	void set_instance_data_channel_internal(EntityInstance &instance_p, int channel_p, float value_p);
+	/// @brief shared material (created on first use)
+	RID get_material_rid();
+	/// @brief channel mapped to the param, mapped to the first free channel
+	/// if none (-1 if all channels are used), requires internal mutex
+	int get_param_channel(String const &param_p);
+	/// @brief use one material per instance instead of the instance data
+	bool _per_instance_material = false;
+	/// @brief materials per instance index (created on first use with _per_instance_material)
+	std::unordered_map<int, Ref<ShaderMaterial>> _instance_materials;
+	/// @brief material of the instance (created and set on its canvas item on first use)
+	/// null if the instance has no canvas item, requires internal mutex
+	Ref<ShaderMaterial> get_instance_material(int idx_p);
 
 	smart_list<EntityInstance> _instances;
 
@@ -223,9 +698,28 @@ private:
 	smart_list<DynamicAnimation> dyn_animations;
 	smart_list<RenderingInfo> alt_infos;
 
-	/// @brief last position of instances to lerp
-	std::vector<Vector2> _newPos;
-	std::vector<Vector2> _oldPos;
+	/// @brief positions written by the simulation and published on update_pos
+	PositionSnapshots _positions;
+	/// @brief last two snapshots acquired to lerp (rendering side)
+	PositionBuffer _newPos;
+	PositionBuffer _oldPos;
+	/// @brief tick of the last snapshot acquired
+	uint64_t _positions_tick = 0;
+
+	/// @brief jitter buffer
+	int _jitter_buffer_size = 0;
+	double _render_delay = 0.1;
+	double _max_extrapolation = 0.05;
+	PositionHistory _history;
+	/// @brief estimate of the simulation time on the rendering side
+	/// advanced by the frame time and corrected by every snapshot acquired
+	double _sim_clock = 0.;
+	/// @brief drift above which the simulation clock jumps to the last snapshot time
+	static constexpr double SIM_CLOCK_RESYNC = 0.25;
+	/// @brief part of the drift corrected on every snapshot
+	static constexpr double SIM_CLOCK_CORRECTION = 0.1;
+	/// @brief interpolated positions computed at the beginning of the draw
+	PositionBuffer _drawPos;
 	smart_list<PositionIndex> pos_indexes;
 
 	/// @brief expected duration of a timestep
@@ -237,19 +731,163 @@ private:
 	/// @brief time since last position update
 	double _elapsedTime = 0.;
 
+	/// @brief culling data
+	bool _culling = false;
+	/// @brief margin around the camera rect (to handle interpolation and big textures)
+	double _culling_margin = 128.;
+	/// @brief grid of position indexes (from the last positions acquired)
+	/// only written by the rendering side, the lock guards the queries of picking from other threads
+	SpatialGrid _grid;
+	mutable std::mutex _grid_mutex;
+	/// @brief visible flag per position index
+	std::vector<char> _visible_positions;
+
+	/// @brief timers of the end of the current frame of every animation
+	TimerWheel _timer_wheel;
+	/// @brief last stamp used for a timer
+	uint64_t _timer_stamp = 0;
+	/// @brief instances which animation has been (re)started and must be scheduled
+	/// (protected by internal mutex)
+	std::vector<int> _to_schedule;
+	/// @brief buffers used during draw only
+	std::vector<int> _scheduling;
+	std::vector<int> _retry_schedule;
+	std::vector<TimerEntry> _due_timers;
+	std::vector<AnimationUpdate> _due_updates;
+
+	/// @brief draw commands of the current draw (grouped by component mask)
+	std::vector<DrawCommand> _draw_commands;
+	/// @brief first draw command of every component mask (and end)
+	std::array<size_t, COMPONENT_MASK_COUNT + 1> _mask_group_commands;
+	/// @brief offset of the draw commands processed by the current task
+	size_t _mask_group_offset = 0;
+
+	/// @brief indexes of the instances with an animation per component mask
+	/// (components are not moved : they stay in the smart lists)
+	std::array<std::vector<int>, COMPONENT_MASK_COUNT> _mask_groups;
+	/// @brief components have been added or removed since the last rebuild
+	std::atomic<bool> _mask_groups_dirty {true};
+	/// @brief rebuild the indexes per component mask if dirty
+	void update_mask_groups();
+	void set_component(EntityInstance &instance_p, int component_p, bool present_p);
+
+	/// @brief instances to free at the end of the draw
+	std::vector<smart_list_handle<EntityInstance> > _deferred_frees;
+	/// @brief canvas items to clear after instances have been freed
+	/// (protected by internal mutex)
+	std::vector<RID> _released_rids;
+
+	/// @brief queued mutations
+	bool _command_queue = false;
+	/// @brief commands pushed when the ring is full go to the overflow list of the queue
+	static size_t const COMMAND_QUEUE_CAPACITY = 1024;
+	CommandQueue<EntityCommand> _commands {COMMAND_QUEUE_CAPACITY};
+	int _command_queue_depth = 0;
+	double _command_queue_latency = 0.;
+	double _command_queue_max_latency = 0.;
+
+	/// @brief parallel update
+	bool _parallel = false;
+	/// @brief minimum number of elements to dispatch to worker threads
+	size_t _parallel_threshold = 1024;
+
+	/// @brief number of entities skipped during last draw (not dirty)
+	int _skipped_draw_count = 0;
+
 	/// @brief an alternative rendering layer used to render the entities
 	/// differently (used for mouse picking)
 	TextureCatcher *_texture_catcher = nullptr;
 	Ref<Shader> _alt_shader;
+	/// @brief material shared by all instances in the alternative rendering
+	Ref<ShaderMaterial> _alt_material;
+
+	/// @brief picking
+	int _picking_mode = PICKING_TEXTURE;
+	/// @brief last picking texture read back
+	mutable PickingBuffer _picking_buffer;
+	mutable uint64_t _picking_buffer_version = uint64_t(-1);
+	/// @brief screen position of the first pixel of the picking buffer
+	mutable Vector2 _picking_buffer_origin;
+	/// @brief process frame the picking buffer was read at
+	mutable uint64_t _picking_buffer_frame = 0;
+	/// @brief asynchronous read back (one at a time), described when requested
+	bool _readback_in_flight = false;
+	uint64_t _readback_version = 0;
+	uint64_t _readback_frame = 0;
+	Vector2 _readback_origin;
+	Vector2i _readback_size;
+	/// @brief data received from the rendering device (may be called from the render thread)
+	std::mutex _readback_mutex;
+	bool _readback_received = false;
+	PackedByteArray _readback_data;
+	bool _picking_on_demand = false;
+	/// @brief true while resolving requests (picking texture read back once)
+	mutable bool _picking_buffer_locked = false;
+	int _next_pick_ticket = 1;
+	std::vector<PickRequest> _pick_requests;
+	std::unordered_map<int, PickResult> _pick_results;
+	/// @brief number of frames a result is kept (and maximum wait for a render)
+	static uint64_t const PICK_RESULT_FRAMES = 60;
+	/// @brief pickable entities removed since last draw
+	std::atomic<bool> _picking_changed {false};
+	double _picking_margin = 128.;
+	/// @brief main instance per position index (-1 if free)
+	std::vector<int> _pos_owners;
+	/// @brief free slots of the position buffers
+	/// min heap : the lowest slot is reused first, slots past the buffers (dropped by a bounded
+	/// compaction) are discarded once they reach the top
+	std::vector<uint32_t> _free_positions;
+	/// @brief free slots past the buffers still in _free_positions
+	size_t _stale_free_positions = 0;
+	void push_free_position(uint32_t idx_p);
+	uint32_t pop_free_position();
+
+	/// @brief compaction of the position buffers
+	bool _compaction = false;
+	bool _compacting = false;
+	/// @brief positions moved by the writer since the last process (positions_compacted)
+	std::atomic<bool> _positions_compacted {false};
+	double _compaction_threshold = 0.25;
+	double _compaction_time_budget = 0.5;
+	/// @brief number of positions moved between two deadline checks
+	static size_t const COMPACTION_STEP = 64;
+	/// @brief ratio of free slots in the position buffers (requires internal mutex)
+	double position_fragmentation() const;
+	/// @brief move positions from the end in the free slots then truncate the buffers
+	/// (requires internal mutex)
+	/// @return the number of positions moved
+	size_t process_compaction(bool bounded_p);
+	/// @brief move the position of the slot from_p to the free slot to_p (requires internal mutex)
+	void move_position(uint32_t from_p, uint32_t to_p);
 
 	// properties
 	double _scale_viewport = 2.;
 	NodePath _ref_camera_path;
+	NodePath _frames_library_path;
+
+	/// @brief library used to share baked frames (optional)
+	FramesLibrary *_frames_library = nullptr;
+	/// @brief baked frames used when no library is set
+	BakedFramesTable _baked_frames;
+	/// @brief instance ids of the sprite frames connected to _on_sprite_frames_changed
+	std::unordered_set<uint64_t> _watched_frames;
 
 	AbstractEntityPayload * _payload_handler = new NoOpEntityPayload();
 
 	double const _scale = 1.;
 
+	/// @brief if true entities are grouped per texture
+	/// and rendered through multimeshes instead of one canvas item each
+	bool _batched = false;
+	mutable bool _batched_warned = false;
+	std::vector<std::unique_ptr<MultiMeshBatch> > _batches;
+	/// @brief index of the batch for every (texture, z index)
+	std::map<std::pair<int64_t, int>, int> _batch_indexes;
+	/// @brief quad mesh shared by all batches
+	RID _batch_mesh;
+	/// @brief material used to map the uv region of every instance
+	Ref<ShaderMaterial> _batch_material;
+
 	/// @brief internal mutex lock when modifying smart lists
 	mutable std::mutex _internal_mutex;
 };
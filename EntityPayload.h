@@ -12,6 +12,8 @@ public:
 	virtual ~AbstractEntityPayload() {}
 	virtual void add_payload() = 0;
 	virtual void free_payload(int idx_p) = 0;
+	/// @brief add multiple payloads at once
+	virtual void add_payloads(size_t count_p) { for(size_t i = 0 ; i < count_p ; ++ i) { add_payload(); } }
 };
 
 /// @brief a no op payload (not containing anything)
@@ -19,6 +21,7 @@ class NoOpEntityPayload : public AbstractEntityPayload {
 public:
 	void add_payload() override {}
 	void free_payload(int) override {}
+	void add_payloads(size_t) override {}
 };
 
 /// @brief a basic template payload
@@ -27,6 +30,13 @@ class EntityPayload : public AbstractEntityPayload {
 public:
 	void add_payload() override { _list.new_instance(T()); }
 	void free_payload(int idx_p) override { _list.free_instance(idx_p); }
+	void add_payloads(size_t count_p) override
+	{
+		for(size_t i = 0 ; i < count_p ; ++ i)
+		{
+			_list.new_instance(T());
+		}
+	}
 
 	T& get_payload(int idx_p)
 	{
@@ -2,10 +2,234 @@
 
 namespace godot {
 
+TextureRegion resolve_region(Ref<Texture2D> const &texture_p)
+{
+	TextureRegion region_l;
+	AtlasTexture const *atlas_l = Object::cast_to<AtlasTexture>(texture_p.ptr());
+	if(atlas_l && atlas_l->get_atlas().is_valid())
+	{
+		Vector2 atlas_size_l = atlas_l->get_atlas()->get_size();
+		Rect2 rect_l = atlas_l->get_region();
+		region_l.texture = atlas_l->get_atlas()->get_rid();
+		region_l.uv = Rect2(rect_l.get_position() / atlas_size_l, rect_l.get_size() / atlas_size_l);
+		region_l.size = rect_l.get_size();
+		region_l.margin = atlas_l->get_margin().get_position();
+	}
+	else if(texture_p.is_valid())
+	{
+		region_l.texture = texture_p->get_rid();
+		region_l.uv = Rect2(0, 0, 1, 1);
+		region_l.size = texture_p->get_size();
+	}
+	return region_l;
+}
+
+namespace
+{
+	/// @brief prefixes of the directed animations in the order of DirectionHandler
+	char const * const DIRECTION_PREFIXES[4] = {"up_", "down_", "left_", "right_"};
+	DirectionalIds const NO_DIRECTIONAL_IDS = {-1, -1, -1, -1};
+}
+
+int BakedFramesTable::bake(Ref<SpriteFrames> const &frames_p)
+{
+	if(frames_p.is_null())
+	{
+		return -1;
+	}
+	std::lock_guard<std::mutex> lock_l(_bake_mutex);
+	return bake_internal(frames_p);
+}
+
+BakedFrame BakedFramesTable::bake_frame(Ref<SpriteFrames> const &frames_p, StringName const &animation_p, int frame_p, double speed_p) const
+{
+	BakedFrame baked_l;
+	baked_l.texture = frames_p->get_frame_texture(animation_p, frame_p);
+	baked_l.region = resolve_region(baked_l.texture);
+	baked_l.duration = frames_p->get_frame_duration(animation_p, frame_p) / speed_p;
+	if(_bake_masks)
+	{
+		baked_l.mask = bake_mask(baked_l.texture);
+	}
+	return baked_l;
+}
+
+int BakedFramesTable::bake_internal(Ref<SpriteFrames> const &frames_p)
+{
+	auto it_l = _frames_ids.find(frames_p->get_instance_id());
+	if(it_l != _frames_ids.end())
+	{
+		return it_l->second;
+	}
+
+	// frames and animations are checked before baking the first one
+	size_t frame_count_l = 0;
+	PackedStringArray names_l = frames_p->get_animation_names();
+	for(int64_t i = 0 ; i < names_l.size() ; ++ i)
+	{
+		frame_count_l += frames_p->get_frame_count(names_l[i]);
+	}
+	ERR_FAIL_COND_V_MSG(_baked.full() || _animations.size() + names_l.size() > _animations.capacity()
+		|| _frames.size() + frame_count_l > _frames.capacity(), -1, "baked frames table is full");
+
+	int frames_id_l = int(_baked.size());
+	_baked.push_back(frames_p);
+	_animation_ids.emplace_back();
+	_directional_ids.emplace_back();
+
+	for(int64_t i = 0 ; i < names_l.size() ; ++ i)
+	{
+		StringName name_l = names_l[i];
+		BakedAnimation animation_l;
+		animation_l.first_frame = int(_frames.size());
+		animation_l.frame_count = frames_p->get_frame_count(name_l);
+		double speed_l = frames_p->get_animation_speed(name_l);
+		for(int frame_l = 0 ; frame_l < animation_l.frame_count ; ++ frame_l)
+		{
+			BakedFrame const &baked_l = _frames.push_back(bake_frame(frames_p, name_l, frame_l, speed_l));
+			animation_l.duration += baked_l.duration;
+		}
+		_animation_ids[frames_id_l][name_l] = int(_animations.size());
+
+		// register the animation as a direction of its base animation
+		String name_str_l = names_l[i];
+		for(int dir_l = 0 ; dir_l < 4 ; ++ dir_l)
+		{
+			String prefix_l(DIRECTION_PREFIXES[dir_l]);
+			if(name_str_l.begins_with(prefix_l))
+			{
+				StringName base_l = name_str_l.substr(prefix_l.length());
+				auto it_l = _directional_ids[frames_id_l].emplace(base_l, NO_DIRECTIONAL_IDS).first;
+				it_l->second[dir_l] = int(_animations.size());
+			}
+		}
+		_animations.push_back(animation_l);
+	}
+
+	_frames_ids[frames_p->get_instance_id()] = frames_id_l;
+	return frames_id_l;
+}
+
+int BakedFramesTable::rebake(Ref<SpriteFrames> const &frames_p)
+{
+	if(frames_p.is_null())
+	{
+		return -1;
+	}
+	std::lock_guard<std::mutex> lock_l(_bake_mutex);
+	auto it_l = _frames_ids.find(frames_p->get_instance_id());
+	if(it_l == _frames_ids.end() || !has_same_layout(it_l->second, frames_p))
+	{
+		_frames_ids.erase(frames_p->get_instance_id());
+		return bake_internal(frames_p);
+	}
+	// same layout : overwrite the frames of the previous bake (no growth on every change)
+	int frames_id_l = it_l->second;
+	for(auto const &pair_l : _animation_ids[frames_id_l])
+	{
+		BakedAnimation &animation_l = _animations[pair_l.second];
+		double speed_l = frames_p->get_animation_speed(pair_l.first);
+		animation_l.duration = 0.;
+		for(int frame_l = 0 ; frame_l < animation_l.frame_count ; ++ frame_l)
+		{
+			BakedFrame &baked_l = _frames[animation_l.first_frame + frame_l];
+			baked_l = bake_frame(frames_p, pair_l.first, frame_l, speed_l);
+			animation_l.duration += baked_l.duration;
+		}
+	}
+	return frames_id_l;
+}
+
+bool BakedFramesTable::has_same_layout(int frames_id_p, Ref<SpriteFrames> const &frames_p) const
+{
+	auto const &ids_l = _animation_ids[frames_id_p];
+	PackedStringArray names_l = frames_p->get_animation_names();
+	if(size_t(names_l.size()) != ids_l.size())
+	{
+		return false;
+	}
+	for(int64_t i = 0 ; i < names_l.size() ; ++ i)
+	{
+		StringName name_l = names_l[i];
+		auto it_l = ids_l.find(name_l);
+		if(it_l == ids_l.end() || _animations[it_l->second].frame_count != frames_p->get_frame_count(name_l))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int BakedFramesTable::get_animation_id(int frames_id_p, StringName const &animation_p) const
+{
+	if(frames_id_p < 0)
+	{
+		return -1;
+	}
+	auto const &ids_l = _animation_ids[frames_id_p];
+	auto it_l = ids_l.find(animation_p);
+	if(it_l == ids_l.end())
+	{
+		return -1;
+	}
+	return it_l->second;
+}
+
+DirectionalIds const & BakedFramesTable::get_directional_ids(int frames_id_p, StringName const &base_animation_p) const
+{
+	if(frames_id_p < 0 || base_animation_p.is_empty())
+	{
+		return NO_DIRECTIONAL_IDS;
+	}
+	auto const &ids_l = _directional_ids[frames_id_p];
+	auto it_l = ids_l.find(base_animation_p);
+	if(it_l == ids_l.end())
+	{
+		return NO_DIRECTIONAL_IDS;
+	}
+	return it_l->second;
+}
+
+void BakedFramesTable::set_bake_masks(bool bake_masks_p)
+{
+	std::lock_guard<std::mutex> lock_l(_bake_mutex);
+	if(bake_masks_p && !_bake_masks)
+	{
+		for(size_t i = 0 ; i < _frames.size() ; ++ i)
+		{
+			_frames[i].mask = bake_mask(_frames[i].texture);
+		}
+	}
+	_bake_masks = bake_masks_p;
+}
+
+Ref<BitMap> BakedFramesTable::bake_mask(Ref<Texture2D> const &texture_p)
+{
+	if(texture_p.is_null())
+	{
+		return Ref<BitMap>();
+	}
+	// atlas textures return the image of their region
+	Ref<Image> image_l = texture_p->get_image();
+	if(image_l.is_null() || image_l->is_empty())
+	{
+		return Ref<BitMap>();
+	}
+	if(image_l->is_compressed())
+	{
+		image_l->decompress();
+	}
+	Ref<BitMap> mask_l;
+	mask_l.instantiate();
+	// same threshold as the picking shader (alpha is rounded)
+	mask_l->create_from_image_alpha(image_l, 0.5);
+	return mask_l;
+}
+
 void FramesLibrary::addFrame(String const &name_p, Ref<SpriteFrames> const &frame_p, Vector2 const &offset_p, bool has_up_down_p)
 {
 	std::string name_l(name_p.utf8().get_data());
-	_mapFrames[name_l] = { frame_p, offset_p, has_up_down_p };
+	_mapFrames[name_l] = { frame_p, offset_p, has_up_down_p, _baked_frames.bake(frame_p) };
 }
 
 FrameInfo const & FramesLibrary::getFrameInfo(std::string const &name_p)
@@ -27,6 +251,10 @@ void FramesLibrary::_bind_methods()
 {
 	ClassDB::bind_method(D_METHOD("addFrame", "name", "frame", "offset", "has_up_down"), &FramesLibrary::addFrame);
 
+	ClassDB::bind_method(D_METHOD("set_bake_masks", "bake_masks"), &FramesLibrary::set_bake_masks);
+	ClassDB::bind_method(D_METHOD("is_bake_masks"), &FramesLibrary::is_bake_masks);
+	ClassDB::add_property("FramesLibrary", PropertyInfo(Variant::BOOL, "bake_masks"), "set_bake_masks", "is_bake_masks");
+
 	ADD_GROUP("FramesLibrary", "FramesLibrary_");
 }
 
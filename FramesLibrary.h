@@ -2,15 +2,26 @@
 
 #ifdef GD_EXTENSION_GODOCTOPUS
 	#include <godot_cpp/godot.hpp>
+	#include <godot_cpp/classes/atlas_texture.hpp>
+	#include <godot_cpp/classes/bit_map.hpp>
 	#include <godot_cpp/classes/node.hpp>
 	#include <godot_cpp/classes/sprite_frames.hpp>
+	#include <godot_cpp/classes/texture2d.hpp>
 #else
 	#include "scene/main/node.h"
+	#include "scene/resources/atlas_texture.h"
+	#include "scene/resources/bit_map.h"
 	#include "scene/resources/sprite_frames.h"
+	#include "scene/resources/texture.h"
 #endif
 
+#include "StableVector.h"
+
+#include <array>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace godot {
 
@@ -19,6 +30,120 @@ struct FrameInfo
 	Ref<SpriteFrames> sprite_frame;
 	Vector2 offset;
 	bool has_up_down = true;
+	/// @brief id of the sprite frames in the baked table
+	int frames_id = -1;
+};
+
+/// @brief region of a texture to draw
+/// resolved from the atlas when the texture is an AtlasTexture
+struct TextureRegion
+{
+	/// @brief texture to bind (the atlas if any)
+	RID texture;
+	/// @brief uv rect of the region (position, size) in [0,1]
+	Rect2 uv;
+	/// @brief size of the region in pixels
+	Vector2 size;
+	/// @brief offset to apply when drawing (margin of the atlas)
+	Vector2 margin;
+};
+
+TextureRegion resolve_region(Ref<Texture2D> const &texture_p);
+
+/// @brief frame of an animation baked from a SpriteFrames
+struct BakedFrame
+{
+	/// @brief texture of the frame (may be null)
+	Ref<Texture2D> texture;
+	TextureRegion region;
+	/// @brief duration of the frame in seconds (animation speed applied)
+	double duration = 0.;
+	/// @brief alpha mask of the region (only if masks are baked)
+	Ref<BitMap> mask;
+};
+
+/// @brief animation baked from a SpriteFrames
+struct BakedAnimation
+{
+	/// @brief index of the first frame in the frame table
+	int first_frame = 0;
+	int frame_count = 0;
+	/// @brief total duration of the animation in seconds
+	double duration = 0.;
+};
+
+/// @brief ids of the directed animations ("up_", "down_", "left_" and "right_"
+/// prefixes) of a base animation in the order of DirectionHandler (-1 if missing)
+typedef std::array<int, 4> DirectionalIds;
+
+struct StringNameHasher
+{
+	std::size_t operator()(StringName const &name_p) const { return name_p.hash(); }
+};
+
+/// @brief Flat tables of all the frames of the baked SpriteFrames
+/// Avoid StringName lookups in the SpriteFrames when drawing, frames of
+/// an animation are contiguous and accessed by index
+/// Tables are append only : baking never moves the frames already baked so
+/// frames referenced by draw commands stay valid while another thread bakes
+/// Baking is serialized by the table (a library may be shared by several drawers)
+class BakedFramesTable
+{
+public:
+	/// @brief bake the sprite frames (if not already baked)
+	/// @return the id of the baked sprite frames (-1 if invalid or if the table is full)
+	int bake(Ref<SpriteFrames> const &frames_p);
+
+	/// @brief bake again sprite frames that changed (on the main thread, from the changed signal)
+	/// if the animations and their frame counts did not change the frames are baked
+	/// again in place and the id is kept, otherwise a new bake is appended and the
+	/// previous one stays valid for the instances still using it
+	/// @return the id of the bake to use
+	int rebake(Ref<SpriteFrames> const &frames_p);
+
+	/// @brief sprite frames of a baked id
+	Ref<SpriteFrames> const & get_sprite_frames(int frames_id_p) const { return _baked[frames_id_p]; }
+
+	/// @brief get the id of an animation of baked sprite frames
+	/// @return -1 if the animation does not exist
+	int get_animation_id(int frames_id_p, StringName const &animation_p) const;
+
+	/// @brief get the ids of the directed animations of a base animation
+	/// resolved when baking (no string concatenation)
+	DirectionalIds const & get_directional_ids(int frames_id_p, StringName const &base_animation_p) const;
+
+	BakedAnimation const & get_animation(int animation_id_p) const { return _animations[animation_id_p]; }
+	BakedFrame const & get_frame(BakedAnimation const &animation_p, int frame_idx_p) const { return _frames[animation_p.first_frame + frame_idx_p]; }
+	/// @brief get a frame from its id in the frame table (first_frame + index in the animation)
+	BakedFrame const & get_frame(int frame_id_p) const { return _frames[frame_id_p]; }
+
+	/// @brief bake alpha masks of all frames (used for picking on the cpu)
+	/// enabling it bakes the masks of the frames already baked
+	void set_bake_masks(bool bake_masks_p);
+	bool is_bake_masks() const { return _bake_masks; }
+
+private:
+	static Ref<BitMap> bake_mask(Ref<Texture2D> const &texture_p);
+	BakedFrame bake_frame(Ref<SpriteFrames> const &frames_p, StringName const &animation_p, int frame_p, double speed_p) const;
+	/// @brief bake appending to the tables (requires the bake mutex)
+	int bake_internal(Ref<SpriteFrames> const &frames_p);
+	/// @brief true if the sprite frames have the animations and frame counts of the bake
+	bool has_same_layout(int frames_id_p, Ref<SpriteFrames> const &frames_p) const;
+
+	/// @brief writers lock (readers rely on the append only tables)
+	std::mutex _bake_mutex;
+	bool _bake_masks = false;
+	StableVector<BakedFrame> _frames;
+	StableVector<BakedAnimation> _animations;
+
+	/// @brief sprite frames baked (kept alive to keep ids valid)
+	StableVector<Ref<SpriteFrames>, 6> _baked;
+	/// @brief animation ids per baked sprite frames
+	StableVector<std::unordered_map<StringName, int, StringNameHasher>, 6> _animation_ids;
+	/// @brief directed animation ids per base name per baked sprite frames
+	StableVector<std::unordered_map<StringName, DirectionalIds, StringNameHasher>, 6> _directional_ids;
+	/// @brief baked id per sprite frames instance id
+	std::unordered_map<uint64_t, int> _frames_ids;
 };
 
 class FramesLibrary : public Node {
@@ -30,12 +155,19 @@ public:
 	FrameInfo const & getFrameInfo(std::string const &name_p);
 	FrameInfo const * tryGetFrameInfo(std::string const &name_p) const;
 
+	BakedFramesTable & get_baked_frames() { return _baked_frames; }
+	BakedFramesTable const & get_baked_frames() const { return _baked_frames; }
+
+	void set_bake_masks(bool bake_masks_p) { _baked_frames.set_bake_masks(bake_masks_p); }
+	bool is_bake_masks() const { return _baked_frames.is_bake_masks(); }
+
 	// Will be called by Godot when the class is registered
 	// Use this to add properties to your class
 	static void _bind_methods();
 
 private:
 	std::unordered_map<std::string, FrameInfo > _mapFrames;
+	BakedFramesTable _baked_frames;
 };
 
 }
@@ -0,0 +1,111 @@
+#include "MultiMeshBatch.h"
+
+#ifdef GD_EXTENSION_GODOCTOPUS
+	#include <godot_cpp/classes/rendering_server.hpp>
+#else
+	#include "servers/rendering_server.h"
+#endif
+
+#include <algorithm>
+
+namespace godot {
+
+MultiMeshBatch::MultiMeshBatch(RID const &texture_p, int z_index_p, RID const &parent_p, RID const &mesh_p, RID const &material_p)
+	: _texture(texture_p), _z_index(z_index_p)
+{
+	RenderingServer *rs_l = RenderingServer::get_singleton();
+	_multimesh = rs_l->multimesh_create();
+	rs_l->multimesh_set_mesh(_multimesh, mesh_p);
+
+	_canvas_item = rs_l->canvas_item_create();
+	rs_l->canvas_item_set_parent(_canvas_item, parent_p);
+	rs_l->canvas_item_set_default_texture_filter(_canvas_item, RenderingServer::CANVAS_ITEM_TEXTURE_FILTER_NEAREST);
+	rs_l->canvas_item_set_material(_canvas_item, material_p);
+	rs_l->canvas_item_set_z_index(_canvas_item, _z_index);
+	rs_l->canvas_item_add_multimesh(_canvas_item, _multimesh, _texture);
+}
+
+MultiMeshBatch::~MultiMeshBatch()
+{
+	RenderingServer *rs_l = RenderingServer::get_singleton();
+	rs_l->free_rid(_canvas_item);
+	rs_l->free_rid(_multimesh);
+}
+
+int MultiMeshBatch::claim_slot()
+{
+	if(!_free_slots.empty())
+	{
+		int slot_l = _free_slots.back();
+		_free_slots.pop_back();
+		return slot_l;
+	}
+	if(_used >= _capacity)
+	{
+		_capacity = std::max(64, _capacity * 2);
+		_buffer.resize(_capacity * STRIDE);
+		for(int i = _used ; i < _capacity ; ++ i)
+		{
+			hide_slot(i);
+		}
+		_resized = true;
+	}
+	_dirty = true;
+	return _used++;
+}
+
+void MultiMeshBatch::release_slot(int slot_p)
+{
+	hide_slot(slot_p);
+	_free_slots.push_back(slot_p);
+	_dirty = true;
+}
+
+void MultiMeshBatch::set_slot(int slot_p, Vector2 const &pos_p, TextureRegion const &region_p)
+{
+	float *data_l = _buffer.ptrw() + slot_p * STRIDE;
+	// transform 2D (basis.x.x, basis.y.x, padding, origin.x, basis.x.y, basis.y.y, padding, origin.y)
+	data_l[0] = region_p.size.x;
+	data_l[1] = 0.f;
+	data_l[2] = 0.f;
+	data_l[3] = pos_p.x;
+	data_l[4] = 0.f;
+	data_l[5] = region_p.size.y;
+	data_l[6] = 0.f;
+	data_l[7] = pos_p.y;
+	// custom data : uv region
+	data_l[8] = region_p.uv.get_position().x;
+	data_l[9] = region_p.uv.get_position().y;
+	data_l[10] = region_p.uv.get_size().x;
+	data_l[11] = region_p.uv.get_size().y;
+	_dirty = true;
+}
+
+void MultiMeshBatch::flush()
+{
+	if(!_dirty)
+	{
+		return;
+	}
+	RenderingServer *rs_l = RenderingServer::get_singleton();
+	if(_resized)
+	{
+		rs_l->multimesh_allocate_data(_multimesh, _capacity, RenderingServer::MULTIMESH_TRANSFORM_2D, false, true);
+		_resized = false;
+	}
+	rs_l->multimesh_set_buffer(_multimesh, _buffer);
+	rs_l->multimesh_set_visible_instances(_multimesh, _used);
+	_dirty = false;
+}
+
+void MultiMeshBatch::hide_slot(int slot_p)
+{
+	// a null basis makes the instance degenerated therefore invisible
+	float *data_l = _buffer.ptrw() + slot_p * STRIDE;
+	for(int i = 0 ; i < STRIDE ; ++ i)
+	{
+		data_l[i] = 0.f;
+	}
+}
+
+} // godot
@@ -0,0 +1,67 @@
+#pragma once
+
+#ifdef GD_EXTENSION_GODOCTOPUS
+	#include <godot_cpp/godot.hpp>
+	#include <godot_cpp/variant/packed_float32_array.hpp>
+#endif
+
+#include <vector>
+
+#include "FramesLibrary.h"
+
+namespace godot {
+
+/// @brief Batch of entities sharing the same texture and z index
+/// that are drawn through a single multimesh
+/// Every entity claims a slot in the batch and write its transform
+/// and uv region in the instance buffer, the buffer is uploaded once per frame
+class MultiMeshBatch
+{
+public:
+	MultiMeshBatch(RID const &texture_p, int z_index_p, RID const &parent_p, RID const &mesh_p, RID const &material_p);
+	~MultiMeshBatch();
+
+	MultiMeshBatch(MultiMeshBatch const &) = delete;
+	MultiMeshBatch & operator=(MultiMeshBatch const &) = delete;
+
+	/// @brief claim a free slot in the batch
+	int claim_slot();
+	/// @brief release the slot (hide it)
+	void release_slot(int slot_p);
+
+	/// @brief write the instance data of the slot
+	void set_slot(int slot_p, Vector2 const &pos_p, TextureRegion const &region_p);
+
+	/// @brief upload the buffer to the rendering server if required
+	void flush();
+
+	RID const & get_texture() const { return _texture; }
+	int get_z_index() const { return _z_index; }
+	int get_used_slots() const { return _used; }
+
+	/// @brief number of floats per instance (transform 2D + custom data)
+	static int const STRIDE = 12;
+
+private:
+	void hide_slot(int slot_p);
+
+	RID _texture;
+	int _z_index = 0;
+
+	RID _canvas_item;
+	RID _multimesh;
+
+	/// @brief instance buffer (transform + custom data)
+	PackedFloat32Array _buffer;
+	/// @brief slots released that can be reused
+	std::vector<int> _free_slots;
+	/// @brief number of allocated instances in the multimesh
+	int _capacity = 0;
+	/// @brief high water mark of slots used
+	int _used = 0;
+
+	bool _dirty = false;
+	bool _resized = false;
+};
+
+} // godot
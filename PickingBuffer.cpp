@@ -0,0 +1,251 @@
+#include "PickingBuffer.h"
+
+#include "PickingScan.h"
+
+#include <algorithm>
+
+namespace godot {
+
+namespace
+{
+	uint32_t load_pixel(uint8_t const *data_p)
+	{
+		return uint32_t(data_p[0]) | (uint32_t(data_p[1]) << 8) | (uint32_t(data_p[2]) << 16) | (uint32_t(data_p[3]) << 24);
+	}
+}
+
+void PickingBuffer::set_image(Ref<Image> const &image_p)
+{
+	if(image_p.is_null() || image_p->is_empty())
+	{
+		_data = PackedByteArray();
+		_width = 0;
+		_height = 0;
+		_pyramid.clear();
+		_pyramid_dirty = true;
+		_large_queries = 0;
+		return;
+	}
+	if(image_p->get_format() != Image::FORMAT_RGBA8)
+	{
+		image_p->convert(Image::FORMAT_RGBA8);
+	}
+	_data = image_p->get_data();
+	_width = image_p->get_width();
+	_height = image_p->get_height();
+	_pyramid_dirty = true;
+	_large_queries = 0;
+}
+
+bool PickingBuffer::set_data(PackedByteArray const &data_p, int width_p, int height_p)
+{
+	if(width_p <= 0 || height_p <= 0 || data_p.size() != int64_t(width_p) * height_p * 4)
+	{
+		return false;
+	}
+	_data = data_p;
+	_width = width_p;
+	_height = height_p;
+	_pyramid_dirty = true;
+	_large_queries = 0;
+	return true;
+}
+
+int PickingBuffer::index_at(int x_p, int y_p) const
+{
+	if(x_p < 0 || x_p >= _width || y_p < 0 || y_p >= _height)
+	{
+		return -1;
+	}
+	uint32_t rgb_l = load_pixel(_data.ptr() + (size_t(y_p) * _width + x_p) * 4) & PICKING_RGB_MASK;
+	return rgb_l == PICKING_BACKGROUND ? -1 : int(rgb_l);
+}
+
+PackedInt32Array PickingBuffer::indexes_in_rect(Rect2i const &rect_p, int max_index_p)
+{
+	PackedInt32Array indexes_l;
+	int min_x_l = std::max(rect_p.get_position().x, 0);
+	int min_y_l = std::max(rect_p.get_position().y, 0);
+	int max_x_l = std::min(rect_p.get_position().x + rect_p.get_size().x, _width - 1);
+	int max_y_l = std::min(rect_p.get_position().y + rect_p.get_size().y, _height - 1);
+	if(min_x_l > max_x_l || min_y_l > max_y_l || max_index_p <= 0)
+	{
+		return indexes_l;
+	}
+	_seen.resize((size_t(max_index_p) + 63) / 64, 0);
+	Bounds bounds_l {min_x_l, min_y_l, max_x_l, max_y_l};
+
+	// no tile can be fully covered : scan directly
+	// building the pyramid costs a full scan : only worth it when the buffer is queried again
+	bool small_l = max_x_l - min_x_l + 1 < 2 * TILE_SIZE || max_y_l - min_y_l + 1 < 2 * TILE_SIZE;
+	if(small_l || (_pyramid_dirty && ++_large_queries < 2))
+	{
+		scan_rect(bounds_l, max_index_p, indexes_l);
+	}
+	else
+	{
+		if(_pyramid_dirty)
+		{
+			build_pyramid();
+		}
+		int top_l = int(_pyramid.size()) - 1;
+		int size_l = _pyramid[top_l].tile_size;
+		for(int ty = min_y_l / size_l ; ty <= max_y_l / size_l ; ++ ty)
+		{
+			for(int tx = min_x_l / size_l ; tx <= max_x_l / size_l ; ++ tx)
+			{
+				collect_tile(top_l, tx, ty, bounds_l, max_index_p, indexes_l);
+			}
+		}
+	}
+
+	// clear only the bits set
+	int32_t const *ptr_l = indexes_l.ptr();
+	for(int64_t i = 0 ; i < indexes_l.size() ; ++ i)
+	{
+		_seen[ptr_l[i] >> 6] = 0;
+	}
+	return indexes_l;
+}
+
+void PickingBuffer::build_pyramid()
+{
+	_pyramid.clear();
+	_pyramid_dirty = false;
+
+	// first level : scan every tile
+	PyramidLevel level_l;
+	level_l.tile_size = TILE_SIZE;
+	level_l.columns = (_width + TILE_SIZE - 1) / TILE_SIZE;
+	level_l.rows = (_height + TILE_SIZE - 1) / TILE_SIZE;
+	level_l.offsets.reserve(size_t(level_l.columns) * level_l.rows + 1);
+	level_l.offsets.push_back(0);
+	_runs.resize(std::max<size_t>(_runs.size(), TILE_SIZE));
+	for(int ty = 0 ; ty < level_l.rows ; ++ ty)
+	{
+		int max_y_l = std::min((ty + 1) * TILE_SIZE, _height);
+		for(int tx = 0 ; tx < level_l.columns ; ++ tx)
+		{
+			size_t first_l = level_l.indexes.size();
+			int min_x_l = tx * TILE_SIZE;
+			int count_l = std::min(TILE_SIZE, _width - min_x_l);
+			for(int y = ty * TILE_SIZE ; y < max_y_l ; ++ y)
+			{
+				size_t runs_l = collect_runs(_data.ptr() + (size_t(y) * _width + min_x_l) * 4, size_t(count_l), _runs.data());
+				level_l.indexes.insert(level_l.indexes.end(), _runs.begin(), _runs.begin() + runs_l);
+			}
+			auto begin_l = level_l.indexes.begin() + first_l;
+			std::sort(begin_l, level_l.indexes.end());
+			level_l.indexes.erase(std::unique(begin_l, level_l.indexes.end()), level_l.indexes.end());
+			level_l.offsets.push_back(uint32_t(level_l.indexes.size()));
+		}
+	}
+	_pyramid.push_back(std::move(level_l));
+
+	// next levels : merge the four children
+	while(_pyramid.back().columns > 1 || _pyramid.back().rows > 1)
+	{
+		PyramidLevel const &child_l = _pyramid.back();
+		PyramidLevel parent_l;
+		parent_l.tile_size = child_l.tile_size * 2;
+		parent_l.columns = (child_l.columns + 1) / 2;
+		parent_l.rows = (child_l.rows + 1) / 2;
+		parent_l.offsets.reserve(size_t(parent_l.columns) * parent_l.rows + 1);
+		parent_l.offsets.push_back(0);
+		for(int ty = 0 ; ty < parent_l.rows ; ++ ty)
+		{
+			for(int tx = 0 ; tx < parent_l.columns ; ++ tx)
+			{
+				size_t first_l = parent_l.indexes.size();
+				for(int cy = 2 * ty ; cy < std::min(2 * ty + 2, child_l.rows) ; ++ cy)
+				{
+					for(int cx = 2 * tx ; cx < std::min(2 * tx + 2, child_l.columns) ; ++ cx)
+					{
+						size_t tile_l = size_t(cy) * child_l.columns + cx;
+						parent_l.indexes.insert(parent_l.indexes.end(),
+							child_l.indexes.begin() + child_l.offsets[tile_l],
+							child_l.indexes.begin() + child_l.offsets[tile_l + 1]);
+					}
+				}
+				auto begin_l = parent_l.indexes.begin() + first_l;
+				std::sort(begin_l, parent_l.indexes.end());
+				parent_l.indexes.erase(std::unique(begin_l, parent_l.indexes.end()), parent_l.indexes.end());
+				parent_l.offsets.push_back(uint32_t(parent_l.indexes.size()));
+			}
+		}
+		_pyramid.push_back(std::move(parent_l));
+	}
+}
+
+void PickingBuffer::collect_tile(int level_p, int tx_p, int ty_p, Bounds const &bounds_p, int max_index_p, PackedInt32Array &indexes_p)
+{
+	PyramidLevel const &level_l = _pyramid[level_p];
+	if(tx_p >= level_l.columns || ty_p >= level_l.rows)
+	{
+		return;
+	}
+	int min_x_l = tx_p * level_l.tile_size;
+	int min_y_l = ty_p * level_l.tile_size;
+	int max_x_l = std::min(min_x_l + level_l.tile_size, _width) - 1;
+	int max_y_l = std::min(min_y_l + level_l.tile_size, _height) - 1;
+	if(max_x_l < bounds_p.min_x || min_x_l > bounds_p.max_x || max_y_l < bounds_p.min_y || min_y_l > bounds_p.max_y)
+	{
+		return;
+	}
+	// fully covered : use the indexes of the tile
+	if(min_x_l >= bounds_p.min_x && max_x_l <= bounds_p.max_x && min_y_l >= bounds_p.min_y && max_y_l <= bounds_p.max_y)
+	{
+		size_t tile_l = size_t(ty_p) * level_l.columns + tx_p;
+		for(uint32_t i = level_l.offsets[tile_l] ; i < level_l.offsets[tile_l + 1] ; ++ i)
+		{
+			add_index(uint32_t(level_l.indexes[i]), max_index_p, indexes_p);
+		}
+		return;
+	}
+	// border of the rect : scan the covered pixels
+	if(level_p == 0)
+	{
+		Bounds covered_l {std::max(min_x_l, bounds_p.min_x), std::max(min_y_l, bounds_p.min_y),
+			std::min(max_x_l, bounds_p.max_x), std::min(max_y_l, bounds_p.max_y)};
+		scan_rect(covered_l, max_index_p, indexes_p);
+		return;
+	}
+	for(int cy = 2 * ty_p ; cy < 2 * ty_p + 2 ; ++ cy)
+	{
+		for(int cx = 2 * tx_p ; cx < 2 * tx_p + 2 ; ++ cx)
+		{
+			collect_tile(level_p - 1, cx, cy, bounds_p, max_index_p, indexes_p);
+		}
+	}
+}
+
+void PickingBuffer::scan_rect(Bounds const &bounds_p, int max_index_p, PackedInt32Array &indexes_p)
+{
+	size_t count_l = size_t(bounds_p.max_x - bounds_p.min_x + 1);
+	_runs.resize(std::max(_runs.size(), count_l));
+	for(int y = bounds_p.min_y ; y <= bounds_p.max_y ; ++ y)
+	{
+		// only the first pixel of every run reaches the bitset
+		size_t runs_l = collect_runs(_data.ptr() + (size_t(y) * _width + bounds_p.min_x) * 4, count_l, _runs.data());
+		for(size_t i = 0 ; i < runs_l ; ++ i)
+		{
+			add_index(_runs[i], max_index_p, indexes_p);
+		}
+	}
+}
+
+void PickingBuffer::add_index(uint32_t idx_p, int max_index_p, PackedInt32Array &indexes_p)
+{
+	if(idx_p >= uint32_t(max_index_p))
+	{
+		return;
+	}
+	uint64_t bit_l = uint64_t(1) << (idx_p & 63);
+	if(!(_seen[idx_p >> 6] & bit_l))
+	{
+		_seen[idx_p >> 6] |= bit_l;
+		indexes_p.push_back(int32_t(idx_p));
+	}
+}
+
+} // godot
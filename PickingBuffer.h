@@ -0,0 +1,88 @@
+#pragma once
+
+#ifdef GD_EXTENSION_GODOCTOPUS
+	#include <godot_cpp/godot.hpp>
+	#include <godot_cpp/classes/image.hpp>
+	#include <godot_cpp/variant/packed_byte_array.hpp>
+	#include <godot_cpp/variant/packed_int32_array.hpp>
+#else
+	#include "core/io/image.h"
+#endif
+
+#include <cstdint>
+#include <vector>
+
+namespace godot {
+
+/// @brief Raw RGBA8 buffer of the picking texture
+/// Every pixel encodes the index of the instance rendered in its rgb
+/// channels (r + g * 256 + b * 256 * 256), white is the background
+class PickingBuffer
+{
+public:
+	/// @brief read the image (converted to RGBA8 if required)
+	void set_image(Ref<Image> const &image_p);
+	/// @brief use raw RGBA8 data (read back from the rendering device)
+	/// @return false if the data does not match the size
+	bool set_data(PackedByteArray const &data_p, int width_p, int height_p);
+
+	int get_width() const { return _width; }
+	int get_height() const { return _height; }
+
+	/// @brief index at the pixel (-1 if background or out of the buffer)
+	int index_at(int x_p, int y_p) const;
+
+	/// @brief unique indexes in the rect (bounds included)
+	/// indexes greater than or equal to max_index_p are ignored
+	/// large rects on a buffer queried more than once use the tile pyramid : only the pixels
+	/// of the tiles partially covered are scanned (the first query scans, building costs a full scan)
+	PackedInt32Array indexes_in_rect(Rect2i const &rect_p, int max_index_p);
+
+	/// @brief size in pixels of the tiles of the first level of the pyramid
+	static int const TILE_SIZE = 16;
+
+private:
+	/// @brief pixel bounds (both included)
+	struct Bounds
+	{
+		int min_x;
+		int min_y;
+		int max_x;
+		int max_y;
+	};
+
+	/// @brief unique indexes of every tile of a level (sorted per tile)
+	/// tiles of a level are twice as large as the ones of the previous level
+	struct PyramidLevel
+	{
+		int tile_size = 0;
+		int columns = 0;
+		int rows = 0;
+		/// @brief indexes of the tile i are in [offsets[i], offsets[i+1])
+		std::vector<uint32_t> offsets;
+		std::vector<int32_t> indexes;
+	};
+
+	/// @brief build the pyramid from the buffer (lazily on the second large query)
+	void build_pyramid();
+	void collect_tile(int level_p, int tx_p, int ty_p, Bounds const &bounds_p, int max_index_p, PackedInt32Array &indexes_p);
+	/// @brief scan the pixels of the rect (bounds included and inside the buffer)
+	void scan_rect(Bounds const &bounds_p, int max_index_p, PackedInt32Array &indexes_p);
+	void add_index(uint32_t idx_p, int max_index_p, PackedInt32Array &indexes_p);
+
+	PackedByteArray _data;
+	int _width = 0;
+	int _height = 0;
+
+	std::vector<PyramidLevel> _pyramid;
+	bool _pyramid_dirty = true;
+	/// @brief large queries since the buffer changed
+	int _large_queries = 0;
+	/// @brief indexes of the runs of the row being scanned
+	std::vector<uint32_t> _runs;
+
+	/// @brief bitset used to remove duplicates (cleared after every query)
+	std::vector<uint64_t> _seen;
+};
+
+} // godot
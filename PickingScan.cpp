@@ -0,0 +1,107 @@
+#include "PickingScan.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define PICKING_SCAN_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+#endif
+
+namespace godot {
+
+namespace
+{
+	uint32_t load_rgb(uint8_t const *data_p)
+	{
+		return uint32_t(data_p[0]) | (uint32_t(data_p[1]) << 8) | (uint32_t(data_p[2]) << 16);
+	}
+
+	/// @brief previous_p : rgb of the pixel before the row (background at the beginning of a row)
+	size_t collect_runs_from(uint8_t const *pixels_p, size_t count_p, uint32_t previous_p, uint32_t *runs_p)
+	{
+		size_t runs_l = 0;
+		for(size_t i = 0 ; i < count_p ; ++ i)
+		{
+			uint32_t rgb_l = load_rgb(pixels_p + i * 4);
+			if(rgb_l != previous_p && rgb_l != PICKING_BACKGROUND)
+			{
+				runs_p[runs_l++] = rgb_l;
+			}
+			previous_p = rgb_l;
+		}
+		return runs_l;
+	}
+}
+
+size_t collect_runs_scalar(uint8_t const *pixels_p, size_t count_p, uint32_t *runs_p)
+{
+	return collect_runs_from(pixels_p, count_p, PICKING_BACKGROUND, runs_p);
+}
+
+size_t collect_runs(uint8_t const *pixels_p, size_t count_p, uint32_t *runs_p)
+{
+	if(count_p == 0)
+	{
+		return 0;
+	}
+	// the first pixel has no previous one to be loaded with it
+	size_t runs_l = collect_runs_from(pixels_p, 1, PICKING_BACKGROUND, runs_p);
+	size_t i = 1;
+	// every pixel is compared with the previous one (loaded shifted by one pixel) and the background :
+	// blocks inside a run or in the background do not leave the vector registers
+#if defined(PICKING_SCAN_SSE2)
+	__m128i mask_l = _mm_set1_epi32(int(PICKING_RGB_MASK));
+	__m128i background_l = _mm_set1_epi32(int(PICKING_BACKGROUND));
+	for( ; i + 4 <= count_p ; i += 4)
+	{
+		__m128i pixels_l = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<__m128i const *>(pixels_p + i * 4)), mask_l);
+		__m128i previous_l = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<__m128i const *>(pixels_p + (i - 1) * 4)), mask_l);
+		// lanes equal to the previous pixel or to the background
+		__m128i same_l = _mm_or_si128(_mm_cmpeq_epi32(pixels_l, previous_l), _mm_cmpeq_epi32(pixels_l, background_l));
+		int starts_l = ~_mm_movemask_ps(_mm_castsi128_ps(same_l)) & 0xF;
+		if(starts_l == 0)
+		{
+			continue;
+		}
+		alignas(16) uint32_t rgb_l[4];
+		_mm_store_si128(reinterpret_cast<__m128i *>(rgb_l), pixels_l);
+		for(int lane = 0 ; lane < 4 ; ++ lane)
+		{
+			if(starts_l & (1 << lane))
+			{
+				runs_p[runs_l++] = rgb_l[lane];
+			}
+		}
+	}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	uint32x4_t mask_l = vdupq_n_u32(PICKING_RGB_MASK);
+	uint32x4_t background_l = vdupq_n_u32(PICKING_BACKGROUND);
+	for( ; i + 4 <= count_p ; i += 4)
+	{
+		uint32x4_t pixels_l = vandq_u32(vreinterpretq_u32_u8(vld1q_u8(pixels_p + i * 4)), mask_l);
+		uint32x4_t previous_l = vandq_u32(vreinterpretq_u32_u8(vld1q_u8(pixels_p + (i - 1) * 4)), mask_l);
+		uint32x4_t same_l = vorrq_u32(vceqq_u32(pixels_l, previous_l), vceqq_u32(pixels_l, background_l));
+		// narrow the lanes to test the four of them at once
+		if(vget_lane_u64(vreinterpret_u64_u16(vmovn_u32(same_l)), 0) == ~uint64_t(0))
+		{
+			continue;
+		}
+		uint32_t rgb_l[4];
+		uint32_t same_lanes_l[4];
+		vst1q_u32(rgb_l, pixels_l);
+		vst1q_u32(same_lanes_l, same_l);
+		for(int lane = 0 ; lane < 4 ; ++ lane)
+		{
+			if(!same_lanes_l[lane])
+			{
+				runs_p[runs_l++] = rgb_l[lane];
+			}
+		}
+	}
+#endif
+	// scalar fallback and remainder
+	runs_l += collect_runs_from(pixels_p + i * 4, count_p - i, load_rgb(pixels_p + (i - 1) * 4), runs_p + runs_l);
+	return runs_l;
+}
+
+} // godot
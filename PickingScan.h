@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace godot {
+
+/// @brief rgb of the background of the picking texture (RGBA8 pixel read little endian, alpha masked)
+static uint32_t const PICKING_BACKGROUND = 0x00FFFFFF;
+static uint32_t const PICKING_RGB_MASK = 0x00FFFFFF;
+
+/// @brief decode a row of RGBA8 pixels (no alignment required) into the indexes of its runs
+/// a run is a sequence of pixels of the same index (rgb), background pixels are skipped
+/// every run writes its index once in runs_p : the same index may be written several
+/// times when runs are separated by other pixels (runs_p must hold count_p values)
+/// decodes, masks and compares several pixels at once when possible (SSE2 or NEON)
+/// does not depend on godot (see bench/picking_scan.cpp)
+/// @return number of runs written
+size_t collect_runs(uint8_t const *pixels_p, size_t count_p, uint32_t *runs_p);
+
+/// @brief same as collect_runs without SIMD instructions (reference and remainder)
+size_t collect_runs_scalar(uint8_t const *pixels_p, size_t count_p, uint32_t *runs_p);
+
+} // godot
@@ -0,0 +1,14 @@
+#include "PositionBuffer.h"
+#include "PositionLerp.h"
+
+namespace godot {
+
+void interpolate_positions(PositionBuffer const &from_p, PositionBuffer const &to_p, float t_p, PositionBuffer &out_p)
+{
+	size_t size_l = from_p.size();
+	out_p.resize(size_l);
+	lerp_floats(from_p.x.data(), to_p.x.data(), t_p, out_p.x.data(), size_l);
+	lerp_floats(from_p.y.data(), to_p.y.data(), t_p, out_p.y.data(), size_l);
+}
+
+} // godot
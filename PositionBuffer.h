@@ -0,0 +1,37 @@
+#pragma once
+
+#ifdef GD_EXTENSION_GODOCTOPUS
+	#include <godot_cpp/godot.hpp>
+#else
+	#include "core/math/vector2.h"
+#endif
+
+#include <vector>
+
+namespace godot {
+
+/// @brief Positions stored as structure of arrays (x and y in separate arrays)
+/// to allow vectorized processing
+/// Coordinates are always stored as float, also when godot is built with
+/// precision=double (real_t is double) : Vector2 are converted on set and get,
+/// which rounds coordinates above 2^24 / 2^n to multiples of 2^-n (0.125 at one million)
+struct PositionBuffer
+{
+	std::vector<float> x;
+	std::vector<float> y;
+
+	size_t size() const { return x.size(); }
+	void resize(size_t size_p) { x.resize(size_p); y.resize(size_p); }
+	void reserve(size_t size_p) { x.reserve(size_p); y.reserve(size_p); }
+	void push_back(Vector2 const &pos_p) { x.push_back(pos_p.x); y.push_back(pos_p.y); }
+
+	Vector2 get(size_t idx_p) const { return Vector2(x[idx_p], y[idx_p]); }
+	void set(size_t idx_p, Vector2 const &pos_p) { x[idx_p] = pos_p.x; y[idx_p] = pos_p.y; }
+};
+
+/// @brief compute out = from + (to - from) * t for every position
+/// uses SIMD instructions when available (AVX, SSE or NEON)
+/// out_p is resized to the size of from_p (to_p must be at least as big)
+void interpolate_positions(PositionBuffer const &from_p, PositionBuffer const &to_p, float t_p, PositionBuffer &out_p);
+
+} // godot
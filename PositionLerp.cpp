@@ -0,0 +1,57 @@
+#include "PositionLerp.h"
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#include <xmmintrin.h>
+	#define ENTITY_DRAWER_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+#endif
+
+namespace godot {
+
+void lerp_floats_scalar(float const *from_p, float const *to_p, float t_p, float *out_p, size_t size_p)
+{
+	for(size_t i = 0 ; i < size_p ; ++ i)
+	{
+		out_p[i] = from_p[i] + (to_p[i] - from_p[i]) * t_p;
+	}
+}
+
+void lerp_floats(float const *from_p, float const *to_p, float t_p, float *out_p, size_t size_p)
+{
+	size_t i = 0;
+#if defined(__AVX__)
+	__m256 t_l = _mm256_set1_ps(t_p);
+	for( ; i + 8 <= size_p ; i += 8)
+	{
+		__m256 from_l = _mm256_loadu_ps(from_p + i);
+		__m256 to_l = _mm256_loadu_ps(to_p + i);
+		__m256 res_l = _mm256_add_ps(from_l, _mm256_mul_ps(_mm256_sub_ps(to_l, from_l), t_l));
+		_mm256_storeu_ps(out_p + i, res_l);
+	}
+#elif defined(ENTITY_DRAWER_SSE)
+	__m128 t_l = _mm_set1_ps(t_p);
+	for( ; i + 4 <= size_p ; i += 4)
+	{
+		__m128 from_l = _mm_loadu_ps(from_p + i);
+		__m128 to_l = _mm_loadu_ps(to_p + i);
+		__m128 res_l = _mm_add_ps(from_l, _mm_mul_ps(_mm_sub_ps(to_l, from_l), t_l));
+		_mm_storeu_ps(out_p + i, res_l);
+	}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	float32x4_t t_l = vdupq_n_f32(t_p);
+	for( ; i + 4 <= size_p ; i += 4)
+	{
+		float32x4_t from_l = vld1q_f32(from_p + i);
+		float32x4_t to_l = vld1q_f32(to_p + i);
+		float32x4_t res_l = vmlaq_f32(from_l, vsubq_f32(to_l, from_l), t_l);
+		vst1q_f32(out_p + i, res_l);
+	}
+#endif
+	// scalar fallback and remainder
+	lerp_floats_scalar(from_p + i, to_p + i, t_p, out_p + i, size_p - i);
+}
+
+} // godot
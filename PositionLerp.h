@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+
+namespace godot {
+
+/// @brief out = from + (to - from) * t on size_p floats
+/// uses SIMD instructions when available (AVX, SSE or NEON)
+/// does not depend on godot (see bench/interpolate_positions.cpp)
+void lerp_floats(float const *from_p, float const *to_p, float t_p, float *out_p, size_t size_p);
+
+/// @brief same as lerp_floats without SIMD instructions (reference and remainder)
+void lerp_floats_scalar(float const *from_p, float const *to_p, float t_p, float *out_p, size_t size_p);
+
+} // godot
@@ -0,0 +1,163 @@
+#include "PositionSnapshots.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace godot {
+
+void PositionSnapshots::reserve(size_t size_p)
+{
+	_state.reserve(size_p);
+	_published.reserve(size_p);
+	_births.reserve(size_p);
+}
+
+uint64_t PositionSnapshots::spawn(size_t idx_p, Vector2 const &pos_p)
+{
+	if(idx_p >= _state.size())
+	{
+		_state.resize(idx_p + 1);
+		_published.resize(idx_p + 1);
+		_births.resize(idx_p + 1);
+	}
+	_state.set(idx_p, pos_p);
+	_published.set(idx_p, pos_p);
+	_births[idx_p] = _tick + 1;
+	return _tick + 1;
+}
+
+void PositionSnapshots::kill(size_t idx_p)
+{
+	if(idx_p < _births.size())
+	{
+		_births[idx_p] = 0;
+	}
+}
+
+void PositionSnapshots::truncate(size_t size_p)
+{
+	if(size_p >= _state.size())
+	{
+		return;
+	}
+	_state.resize(size_p);
+	_published.resize(size_p);
+	_births.resize(size_p);
+}
+
+void PositionSnapshots::publish(double time_p)
+{
+	PositionSnapshot &snapshot_l = _slots[_back];
+	snapshot_l.positions.x.assign(_state.x.begin(), _state.x.end());
+	snapshot_l.positions.y.assign(_state.y.begin(), _state.y.end());
+	snapshot_l.births.assign(_births.begin(), _births.end());
+	snapshot_l.tick = ++_tick;
+	snapshot_l.time = time_p;
+	_published.x.assign(_state.x.begin(), _state.x.end());
+	_published.y.assign(_state.y.begin(), _state.y.end());
+
+	// a snapshot not acquired yet is dropped
+	_back = _middle.exchange(_back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
+
+bool PositionSnapshots::acquire()
+{
+	if(!(_middle.load(std::memory_order_relaxed) & FRESH))
+	{
+		return false;
+	}
+	_front = _middle.exchange(_front, std::memory_order_acq_rel) & ~FRESH;
+	return true;
+}
+
+double PositionSnapshots::now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void PositionHistory::set_capacity(size_t capacity_p)
+{
+	_entries.resize(std::max<size_t>(capacity_p, 2));
+	_first = 0;
+	_count = 0;
+}
+
+void PositionHistory::push(PositionSnapshot const &snapshot_p, uint64_t previous_tick_p)
+{
+	if(_entries.empty())
+	{
+		return;
+	}
+	// overwrite the oldest entry when full
+	size_t slot_l = (_first + _count) % _entries.size();
+	if(_count == _entries.size())
+	{
+		_first = (_first + 1) % _entries.size();
+	}
+	else
+	{
+		++_count;
+	}
+	Entry &entry_l = _entries[slot_l];
+	entry_l.positions.x.assign(snapshot_p.positions.x.begin(), snapshot_p.positions.x.end());
+	entry_l.positions.y.assign(snapshot_p.positions.y.begin(), snapshot_p.positions.y.end());
+	entry_l.time = snapshot_p.time;
+
+	// all entries must have the same size to be interpolated
+	size_t size_l = entry_l.positions.size();
+	for(size_t i = 0 ; i + 1 < _count ; ++ i)
+	{
+		Entry &old_l = _entries[(_first + i) % _entries.size()];
+		size_l = std::max(size_l, old_l.positions.size());
+	}
+	for(size_t i = 0 ; i < _count ; ++ i)
+	{
+		_entries[(_first + i) % _entries.size()].positions.resize(size_l);
+	}
+
+	// new positions are copied in older entries
+	for(size_t idx_l = 0 ; idx_l < snapshot_p.births.size() ; ++ idx_l)
+	{
+		if(snapshot_p.births[idx_l] <= previous_tick_p)
+		{
+			continue;
+		}
+		for(size_t i = 0 ; i + 1 < _count ; ++ i)
+		{
+			_entries[(_first + i) % _entries.size()].positions.set(idx_l, entry_l.positions.get(idx_l));
+		}
+	}
+}
+
+bool PositionHistory::sample(double time_p, double max_extrapolation_p, PositionBuffer &out_p) const
+{
+	if(_count == 0)
+	{
+		return false;
+	}
+	if(_count == 1 || time_p <= get(0).time)
+	{
+		out_p.x.assign(get(0).positions.x.begin(), get(0).positions.x.end());
+		out_p.y.assign(get(0).positions.y.begin(), get(0).positions.y.end());
+		return true;
+	}
+	// find the two entries around the time (extrapolate from the last two if none)
+	size_t next_l = 1;
+	while(next_l + 1 < _count && get(next_l).time < time_p)
+	{
+		++next_l;
+	}
+	Entry const &from_l = get(next_l - 1);
+	Entry const &to_l = get(next_l);
+	double span_l = to_l.time - from_l.time;
+	double t_l = 1.;
+	if(span_l > 0.)
+	{
+		double time_l = std::min(time_p, to_l.time + max_extrapolation_p);
+		t_l = (time_l - from_l.time) / span_l;
+	}
+	interpolate_positions(from_l.positions, to_l.positions, float(t_l), out_p);
+	return true;
+}
+
+} // godot
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "PositionBuffer.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace godot {
+
+/// @brief Positions published by the simulation at a given tick
+struct PositionSnapshot
+{
+	PositionBuffer positions;
+	/// @brief tick of the first publish of every position index (since its last spawn)
+	/// 0 if the position index is free
+	std::vector<uint64_t> births;
+	uint64_t tick = 0;
+	/// @brief simulation time of the positions in seconds
+	/// (local time of the publish if the simulation gives none, see PositionSnapshots::now)
+	double time = 0.;
+};
+
+/// @brief Triple buffer of position snapshots between the simulation (writer)
+/// and the rendering (reader)
+/// The writer fills its own state and publishes it by swapping the back
+/// snapshot with the middle one, the reader acquires the middle snapshot
+/// by swapping it with its front one. Neither side ever blocks on the exchange.
+/// There must be only one writer thread and one reader thread at a time : every
+/// writer side method (spawn, kill, truncate, state, publish) is called by the writer.
+class PositionSnapshots
+{
+public:
+	// writer side
+
+	/// @brief positions being written by the simulation
+	PositionBuffer & state() { return _state; }
+	PositionBuffer const & state() const { return _state; }
+	/// @brief positions of the last publish
+	PositionBuffer const & published() const { return _published; }
+	size_t size() const { return _state.size(); }
+	void reserve(size_t size_p);
+
+	/// @brief set the position of a new entity (position index may be recycled)
+	/// @return the tick of the first publish that will contain it
+	uint64_t spawn(size_t idx_p, Vector2 const &pos_p);
+	/// @brief mark the position index as free in the next publishes
+	void kill(size_t idx_p);
+	/// @brief drop the positions from the given index (compaction)
+	/// snapshots already published keep their size
+	void truncate(size_t size_p);
+
+	/// @brief publish the current state stamped with the simulation time
+	void publish(double time_p);
+
+	// reader side
+
+	/// @brief acquire the last published snapshot if any new
+	/// @return true if a new snapshot has been acquired
+	bool acquire();
+	/// @brief last snapshot acquired
+	PositionSnapshot const & front() const { return _slots[_front]; }
+
+	/// @brief monotonic clock in seconds used to timestamp snapshots without simulation time
+	static double now();
+
+private:
+	PositionBuffer _state;
+	PositionBuffer _published;
+	std::vector<uint64_t> _births;
+	uint64_t _tick = 0;
+
+	std::array<PositionSnapshot, 3> _slots;
+	/// @brief slot owned by the writer
+	int _back = 0;
+	/// @brief slot shared (with a flag if not acquired yet)
+	std::atomic<int> _middle {1};
+	/// @brief slot owned by the reader
+	int _front = 2;
+
+	static int const FRESH = 4;
+};
+
+/// @brief Ring of the last snapshots acquired (rendering side)
+/// used to interpolate positions at a delayed time to absorb
+/// irregular publishes (jitter buffer)
+class PositionHistory
+{
+public:
+	/// @brief number of snapshots kept (clears the history)
+	void set_capacity(size_t capacity_p);
+	size_t get_capacity() const { return _entries.size(); }
+	void clear() { _count = 0; }
+
+	/// @brief add a snapshot, positions published for the first time
+	/// are copied in older entries so they do not interpolate from a recycled index
+	void push(PositionSnapshot const &snapshot_p, uint64_t previous_tick_p);
+
+	/// @brief compute positions at the given time
+	/// interpolate between the two snapshots around the time or extrapolate
+	/// from the last two snapshots (for max_extrapolation_p seconds at most)
+	/// @return false if the history is empty
+	bool sample(double time_p, double max_extrapolation_p, PositionBuffer &out_p) const;
+
+private:
+	struct Entry
+	{
+		PositionBuffer positions;
+		double time = 0.;
+	};
+	/// @brief entry from the oldest (0) to the newest (count-1)
+	Entry const & get(size_t i) const { return _entries[(_first + i) % _entries.size()]; }
+
+	std::vector<Entry> _entries;
+	size_t _first = 0;
+	size_t _count = 0;
+};
+
+} // godot
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace godot {
+
+/// @brief Vector storing up to N small copyable values inline
+/// Only allocates on the heap beyond N values
+template<typename T, uint32_t N>
+class SmallVector
+{
+public:
+	SmallVector() = default;
+	SmallVector(SmallVector const &other_p) { assign(other_p); }
+	SmallVector & operator=(SmallVector const &other_p)
+	{
+		if(this != &other_p)
+		{
+			clear();
+			assign(other_p);
+		}
+		return *this;
+	}
+	~SmallVector() { delete[] _heap; }
+
+	uint32_t size() const { return _size; }
+	bool empty() const { return _size == 0; }
+
+	T * begin() { return data(); }
+	T * end() { return data() + _size; }
+	T const * begin() const { return data(); }
+	T const * end() const { return data() + _size; }
+
+	void push_back(T const &value_p)
+	{
+		if(_size == capacity())
+		{
+			grow(capacity() * 2);
+		}
+		data()[_size++] = value_p;
+	}
+
+	/// @brief remove the value (order is kept)
+	/// @return the iterator following the removed value
+	T * erase(T *it_p)
+	{
+		std::copy(it_p + 1, end(), it_p);
+		--_size;
+		return it_p;
+	}
+
+	/// @brief remove all values and release the heap storage
+	void clear()
+	{
+		delete[] _heap;
+		_heap = nullptr;
+		_capacity = N;
+		_size = 0;
+	}
+
+	/// @brief bytes allocated on the heap
+	size_t heap_size() const { return _heap ? _capacity * sizeof(T) : 0; }
+
+private:
+	T * data() { return _heap ? _heap : _inline; }
+	T const * data() const { return _heap ? _heap : _inline; }
+	uint32_t capacity() const { return _capacity; }
+
+	void grow(uint32_t capacity_p)
+	{
+		T *heap_l = new T[capacity_p];
+		std::copy(begin(), end(), heap_l);
+		delete[] _heap;
+		_heap = heap_l;
+		_capacity = capacity_p;
+	}
+
+	void assign(SmallVector const &other_p)
+	{
+		if(other_p._size > N)
+		{
+			grow(other_p._size);
+		}
+		std::copy(other_p.begin(), other_p.end(), data());
+		_size = other_p._size;
+	}
+
+	T _inline[N];
+	T *_heap = nullptr;
+	uint32_t _size = 0;
+	uint32_t _capacity = N;
+};
+
+} // godot
@@ -0,0 +1,73 @@
+#include "SpatialGrid.h"
+
+namespace godot {
+
+void SpatialGrid::set_cell_size(real_t cell_size_p)
+{
+	clear();
+	_cell_size = cell_size_p;
+}
+
+void SpatialGrid::update(size_t idx_p, Vector2 const &pos_p)
+{
+	if(idx_p >= _entries.size())
+	{
+		_entries.resize(idx_p + 1);
+	}
+	Entry &entry_l = _entries[idx_p];
+	int64_t cell_l = key(cell_coord(pos_p.x), cell_coord(pos_p.y));
+	if(entry_l.in_grid)
+	{
+		if(entry_l.cell == cell_l)
+		{
+			return;
+		}
+		remove(idx_p);
+	}
+	std::vector<size_t> &indexes_l = _cells[cell_l];
+	entry_l.in_grid = true;
+	entry_l.cell = cell_l;
+	entry_l.slot = indexes_l.size();
+	indexes_l.push_back(idx_p);
+}
+
+void SpatialGrid::remove(size_t idx_p)
+{
+	if(idx_p >= _entries.size() || !_entries[idx_p].in_grid)
+	{
+		return;
+	}
+	Entry &entry_l = _entries[idx_p];
+	auto it_l = _cells.find(entry_l.cell);
+	std::vector<size_t> &indexes_l = it_l->second;
+	// swap with last element to remove in constant time
+	size_t last_l = indexes_l.back();
+	indexes_l[entry_l.slot] = last_l;
+	_entries[last_l].slot = entry_l.slot;
+	indexes_l.pop_back();
+	if(indexes_l.empty())
+	{
+		_cells.erase(it_l);
+	}
+	entry_l.in_grid = false;
+}
+
+void SpatialGrid::truncate(size_t size_p)
+{
+	for(size_t idx_l = size_p ; idx_l < _entries.size() ; ++ idx_l)
+	{
+		remove(idx_l);
+	}
+	if(size_p < _entries.size())
+	{
+		_entries.resize(size_p);
+	}
+}
+
+void SpatialGrid::clear()
+{
+	_cells.clear();
+	_entries.clear();
+}
+
+} // godot
@@ -0,0 +1,95 @@
+#pragma once
+
+#ifdef GD_EXTENSION_GODOCTOPUS
+	#include <godot_cpp/godot.hpp>
+#else
+	#include "core/math/rect2.h"
+	#include "core/math/vector2.h"
+#endif
+
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+namespace godot {
+
+/// @brief Uniform grid storing indexes per cell
+/// Used to quickly find the position indexes inside a rect
+/// (cells are allocated on demand so the grid is unbounded)
+class SpatialGrid
+{
+public:
+	/// @brief change the size of the cells (clear the grid), must be positive
+	void set_cell_size(real_t cell_size_p);
+	real_t get_cell_size() const { return _cell_size; }
+
+	/// @brief insert or move the index in the grid
+	void update(size_t idx_p, Vector2 const &pos_p);
+	/// @brief remove the index from the grid
+	void remove(size_t idx_p);
+	/// @brief remove all the indexes from the given one
+	void truncate(size_t size_p);
+	bool contains(size_t idx_p) const { return idx_p < _entries.size() && _entries[idx_p].in_grid; }
+	void clear();
+
+	/// @brief call func_p(idx) for every index in cells overlapping the rect
+	template<class func_t>
+	void query(Rect2 const &rect_p, func_t &&func_p) const
+	{
+		int min_x_l = cell_coord(rect_p.get_position().x);
+		int min_y_l = cell_coord(rect_p.get_position().y);
+		int max_x_l = cell_coord(rect_p.get_end().x);
+		int max_y_l = cell_coord(rect_p.get_end().y);
+		// when the rect covers more cells than allocated iterate over allocated cells
+		if(double(max_x_l - min_x_l + 1) * double(max_y_l - min_y_l + 1) > double(_cells.size()))
+		{
+			for(auto const &pair_l : _cells)
+			{
+				int x_l = int(pair_l.first >> 32);
+				int y_l = int(int32_t(pair_l.first & 0xffffffff));
+				if(x_l >= min_x_l && x_l <= max_x_l && y_l >= min_y_l && y_l <= max_y_l)
+				{
+					for(size_t idx_l : pair_l.second)
+					{
+						func_p(idx_l);
+					}
+				}
+			}
+			return;
+		}
+		for(int x_l = min_x_l ; x_l <= max_x_l ; ++ x_l)
+		{
+			for(int y_l = min_y_l ; y_l <= max_y_l ; ++ y_l)
+			{
+				auto it_l = _cells.find(key(x_l, y_l));
+				if(it_l == _cells.end())
+				{
+					continue;
+				}
+				for(size_t idx_l : it_l->second)
+				{
+					func_p(idx_l);
+				}
+			}
+		}
+	}
+
+private:
+	int cell_coord(real_t coord_p) const { return int(std::floor(coord_p / _cell_size)); }
+	static int64_t key(int x_p, int y_p) { return (int64_t(x_p) << 32) | int64_t(uint32_t(y_p)); }
+
+	struct Entry
+	{
+		bool in_grid = false;
+		int64_t cell = 0;
+		/// @brief index in the cell vector
+		size_t slot = 0;
+	};
+
+	real_t _cell_size = 256.;
+	std::unordered_map<int64_t, std::vector<size_t> > _cells;
+	/// @brief entry of every index
+	std::vector<Entry> _entries;
+};
+
+} // godot
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace godot {
+
+/// @brief Append only vector storing its values in chunks of fixed size
+/// Growing never moves the values : references stay valid and the values
+/// already pushed can be read while one thread appends new ones
+template<typename T, uint32_t CHUNK_BITS = 10, uint32_t MAX_CHUNKS = 1024>
+class StableVector
+{
+public:
+	static size_t const CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+
+	StableVector() = default;
+	StableVector(StableVector const &) = delete;
+	StableVector & operator=(StableVector const &) = delete;
+
+	size_t size() const { return _size.load(std::memory_order_acquire); }
+	static size_t capacity() { return CHUNK_SIZE * MAX_CHUNKS; }
+	bool full() const { return size() == capacity(); }
+
+	T & operator[](size_t idx_p) { return _chunks[idx_p >> CHUNK_BITS][idx_p & (CHUNK_SIZE - 1)]; }
+	T const & operator[](size_t idx_p) const { return _chunks[idx_p >> CHUNK_BITS][idx_p & (CHUNK_SIZE - 1)]; }
+
+	/// @brief append a value (must not be full)
+	/// @return the new value
+	T & push_back(T const &value_p)
+	{
+		size_t size_l = _size.load(std::memory_order_relaxed);
+		std::unique_ptr<T[]> &chunk_l = _chunks[size_l >> CHUNK_BITS];
+		if(!chunk_l)
+		{
+			chunk_l.reset(new T[CHUNK_SIZE]);
+		}
+		T &value_l = chunk_l[size_l & (CHUNK_SIZE - 1)];
+		value_l = value_p;
+		// publish the value after it is written
+		_size.store(size_l + 1, std::memory_order_release);
+		return value_l;
+	}
+
+	T & emplace_back() { return push_back(T()); }
+
+private:
+	std::array<std::unique_ptr<T[]>, MAX_CHUNKS> _chunks;
+	std::atomic<size_t> _size {0};
+};
+
+} // namespace godot
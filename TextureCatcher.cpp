@@ -2,12 +2,16 @@
 
 #ifdef GD_EXTENSION_GODOCTOPUS
 	#include <godot_cpp/classes/color_rect.hpp>
+	#include <godot_cpp/classes/engine.hpp>
 	#include <godot_cpp/classes/window.hpp>
 #else
+	#include <core/config/engine.h>
 	#include <scene/gui/color_rect.h>
 	#include <scene/main/window.h>
 #endif
 
+#include <algorithm>
+
 
 namespace godot {
 
@@ -41,7 +45,7 @@ void TextureCatcher::_ready()
 	// - Subviewport : viewport used to render the picking texture
 	_sub_viewport = memnew(SubViewport);
 	add_child(_sub_viewport);
-	_sub_viewport->set_update_mode(SubViewport::UPDATE_ALWAYS);
+	_sub_viewport->set_update_mode(_on_demand ? SubViewport::UPDATE_DISABLED : SubViewport::UPDATE_ALWAYS);
 	_sub_viewport->set_canvas_cull_mask(2);
 	_sub_viewport->set_disable_3d(true);
 
@@ -96,12 +100,135 @@ void TextureCatcher::_process(double delta_p)
 	{
 		_camera->set_position(_ref_camera->get_position());
 		_camera->set_zoom(_ref_camera->get_zoom() / _scale_viewport);
+		// camera moved since last render
+		if(_on_demand
+		&& (_ref_camera->get_position() != _rendered_position || _ref_camera->get_zoom() != _rendered_zoom))
+		{
+			_dirty = true;
+		}
 	}
 	_texture->set_texture(_sub_viewport->get_texture());
+
+	// render requested in a previous frame is now available
+	if(_pending && Engine::get_singleton()->get_process_frames() > _pending_frame)
+	{
+		_pending = false;
+		_rendered_origin = _region_origin;
+		++_version;
+		// regions requested during the render
+		if(_queued)
+		{
+			_queued = false;
+			_region = _queued_region;
+			start_render();
+		}
+	}
+}
+
+void TextureCatcher::set_on_demand(bool on_demand_p)
+{
+	_on_demand = on_demand_p;
+	_dirty = true;
+	if(!_sub_viewport)
+	{
+		return;
+	}
+	_sub_viewport->set_update_mode(_on_demand ? SubViewport::UPDATE_DISABLED : SubViewport::UPDATE_ALWAYS);
+	// back to full screen rendering
+	if(!_on_demand && _ref_camera)
+	{
+		_on_size_changed();
+	}
+}
+
+uint64_t TextureCatcher::request_update(Rect2 const &region_p)
+{
+	if(!_on_demand || !_sub_viewport)
+	{
+		return _version;
+	}
+	Rect2 screen_l(Vector2(), get_screen_size());
+	Rect2 region_l = region_p.has_area() ? region_p.intersection(screen_l) : screen_l;
+	if(!region_l.has_area())
+	{
+		return _version + (_pending ? 1 : 0) + (_queued ? 1 : 0);
+	}
+	if(_pending)
+	{
+		// not rendered yet : grow the region of the render requested this frame
+		if(Engine::get_singleton()->get_process_frames() == _pending_frame)
+		{
+			if(!_region.encloses(region_l))
+			{
+				_region = _region.merge(region_l);
+				apply_region();
+			}
+			return _version + 1;
+		}
+		// render in flight : render the union of the regions requested meanwhile after it
+		_queued_region = _queued ? _queued_region.merge(region_l) : region_l;
+		_queued = true;
+		return _version + 2;
+	}
+	// cached render is still valid
+	if(!_dirty && _region.encloses(region_l))
+	{
+		return _version;
+	}
+	_region = region_l;
+	start_render();
+	return _version + 1;
+}
+
+void TextureCatcher::start_render()
+{
+	apply_region();
+	_sub_viewport->set_update_mode(SubViewport::UPDATE_ONCE);
+	_dirty = false;
+	_pending = true;
+	_pending_frame = Engine::get_singleton()->get_process_frames();
+	if(_ref_camera)
+	{
+		_rendered_position = _ref_camera->get_position();
+		_rendered_zoom = _ref_camera->get_zoom();
+	}
+}
+
+Vector2 TextureCatcher::get_screen_size() const
+{
+	if(_ref_camera && _ref_camera->get_viewport())
+	{
+		return _ref_camera->get_viewport()->get_visible_rect().get_size();
+	}
+	return Vector2(_sub_viewport->get_size().x, _sub_viewport->get_size().y) * _scale_viewport;
+}
+
+void TextureCatcher::apply_region()
+{
+	Vector2 size_l = (_region.get_size() / _scale_viewport).ceil();
+	_sub_viewport->set_size(Vector2i(std::max(1, int(size_l.x)), std::max(1, int(size_l.y))));
+	// the camera of the viewport is centered on the region
+	Vector2 center_l = _region.get_position() + _region.get_size() / 2.;
+	_region_origin = center_l - size_l * _scale_viewport / 2.;
+	if(_ref_camera)
+	{
+		_camera->set_offset((center_l - get_screen_size() / 2.) / _ref_camera->get_zoom());
+	}
 }
 
 void TextureCatcher::_on_size_changed()
 {
+	// full screen region
+	_dirty = true;
+	_region = Rect2();
+	_region_origin = Vector2();
+	// rendered every frame : the texture follows the region at once
+	if(!_on_demand)
+	{
+		_rendered_origin = Vector2();
+	}
+	_camera->set_offset(Vector2());
+
 	SubViewport * sub_l = dynamic_cast<SubViewport *>(_ref_camera->get_viewport());
 	Window * window_l = dynamic_cast<Window *>(_ref_camera->get_viewport());
 	if(sub_l)
@@ -130,6 +257,11 @@ void TextureCatcher::_bind_methods()
 	ClassDB::bind_method(D_METHOD("set_ref_camera", "ref_camera"), &TextureCatcher::set_ref_camera);
 	ClassDB::add_property("TextureCatcher", PropertyInfo(Variant::NODE_PATH, "ref_camera", PROPERTY_HINT_NODE_PATH_VALID_TYPES, "Camera2D"), "set_ref_camera", "get_ref_camera");
 
+	ClassDB::bind_method(D_METHOD("set_on_demand", "on_demand"), &TextureCatcher::set_on_demand);
+	ClassDB::bind_method(D_METHOD("is_on_demand"), &TextureCatcher::is_on_demand);
+	ClassDB::add_property("TextureCatcher", PropertyInfo(Variant::BOOL, "on_demand"), "set_on_demand", "is_on_demand");
+	ClassDB::bind_method(D_METHOD("request_update", "region"), &TextureCatcher::request_update);
+
 	ADD_GROUP("TextureCatcher", "TextureCatcher_");
 }
 
@@ -44,6 +44,8 @@ public:
 
 	Node2D * get_alt_viewport() { return _alt_viewport; }
 	Ref<ViewportTexture> get_texture() const { return _sub_viewport->get_texture(); }
+	/// @brief size in pixels of the texture
+	Vector2i get_texture_size() const { return _sub_viewport->get_size(); }
 
 	// signal
 	void _on_size_changed();
@@ -58,6 +60,25 @@ public:
 	NodePath const & get_ref_camera() const { return _ref_camera_path; }
 	void set_ref_camera(NodePath const &ref_camera) { _ref_camera_path = ref_camera; }
 
+	/// @brief if true the viewport is only rendered when requested (see request_update)
+	void set_on_demand(bool on_demand_p);
+	bool is_on_demand() const { return _on_demand; }
+	/// @brief request a render of the region (in screen pixels, full screen if empty)
+	/// nothing is rendered if the last render covers the region and nothing changed since
+	/// the render is available in the next frame (see get_version)
+	/// requests of the same frame are merged in one render, requests made while a render
+	/// is in flight are merged and rendered once it is available
+	/// @return the version of the render that will cover the region
+	uint64_t request_update(Rect2 const &region_p);
+	/// @brief flag the last render as outdated (entities changed)
+	void mark_dirty() { _dirty = true; }
+	/// @brief screen position of the first pixel of the last render available
+	/// (changes with the version, not when a region is requested)
+	Vector2 const & get_rendered_origin() const { return _rendered_origin; }
+	/// @brief incremented every time a new render is available
+	uint64_t get_version() const { return _version; }
+	bool is_pending() const { return _pending; }
+
 protected:
 	void _notification(int p_notification);
 private:
@@ -69,6 +90,34 @@ private:
 	CanvasLayer *_debug_canvas = nullptr;
 	TextureRect *_texture = nullptr;
 	Sprite2D *_alt_viewport = nullptr;
+
+	/// @brief size of the viewport of the ref camera
+	Vector2 get_screen_size() const;
+	/// @brief resize the viewport and offset its camera to render the region only
+	void apply_region();
+	/// @brief render _region in the next frame
+	void start_render();
+
+	// on demand rendering
+	bool _on_demand = false;
+	/// @brief true if the last render is outdated
+	bool _dirty = true;
+	/// @brief true if a render has been requested and is not available yet
+	bool _pending = false;
+	uint64_t _pending_frame = 0;
+	uint64_t _version = 0;
+	/// @brief true if a region was requested while a render was in flight
+	bool _queued = false;
+	/// @brief union of the regions requested while a render was in flight
+	Rect2 _queued_region;
+	/// @brief region requested (in screen pixels)
+	Rect2 _region;
+	/// @brief origin of the region requested, latched as the rendered one with the version
+	Vector2 _region_origin;
+	Vector2 _rendered_origin;
+	/// @brief camera state of the last render
+	Vector2 _rendered_position;
+	Vector2 _rendered_zoom;
 };
 
 }
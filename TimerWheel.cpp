@@ -0,0 +1,116 @@
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace godot {
+
+TimerWheel::TimerWheel(double resolution_p, size_t slots_p)
+	: _resolution(resolution_p), _slots(slots_p)
+{}
+
+void TimerWheel::schedule(double time_p, int idx_p, uint64_t stamp_p)
+{
+	insert({time_p, idx_p, stamp_p});
+	++_size;
+}
+
+void TimerWheel::pop_due(double time_p, std::vector<TimerEntry> &due_p)
+{
+	due_p.clear();
+	int64_t target_l = tick(time_p);
+	int64_t slots_l = int64_t(_slots.size());
+	// no need to visit a slot twice
+	int64_t first_l = std::max(_current_tick, target_l - slots_l + 1);
+	for(int64_t tick_l = first_l ; tick_l <= target_l ; ++ tick_l)
+	{
+		std::vector<TimerEntry> &slot_l = _slots[tick_l % slots_l];
+		// keep entries that are not due yet (same slot as target)
+		size_t kept_l = 0;
+		for(TimerEntry const &entry_l : slot_l)
+		{
+			if(entry_l.time <= time_p)
+			{
+				due_p.push_back(entry_l);
+			}
+			else
+			{
+				slot_l[kept_l++] = entry_l;
+			}
+		}
+		slot_l.resize(kept_l);
+	}
+	_current_tick = std::max(_current_tick, target_l);
+	_size -= due_p.size();
+
+	if(_current_tick >= _next_overflow_tick)
+	{
+		migrate_overflow();
+		_next_overflow_tick = _current_tick + slots_l / 2;
+		// migrated entries may already be due
+		std::vector<TimerEntry> &slot_l = _slots[_current_tick % slots_l];
+		size_t kept_l = 0;
+		for(TimerEntry const &entry_l : slot_l)
+		{
+			if(entry_l.time <= time_p)
+			{
+				due_p.push_back(entry_l);
+				--_size;
+			}
+			else
+			{
+				slot_l[kept_l++] = entry_l;
+			}
+		}
+		slot_l.resize(kept_l);
+	}
+}
+
+void TimerWheel::clear()
+{
+	for(std::vector<TimerEntry> &slot_l : _slots)
+	{
+		slot_l.clear();
+	}
+	_overflow.clear();
+	_size = 0;
+}
+
+int64_t TimerWheel::tick(double time_p) const
+{
+	return int64_t(std::floor(time_p / _resolution));
+}
+
+void TimerWheel::insert(TimerEntry const &entry_p)
+{
+	int64_t slots_l = int64_t(_slots.size());
+	// late entries are due on next pop
+	int64_t tick_l = std::max(tick(entry_p.time), _current_tick);
+	if(tick_l - _current_tick >= slots_l)
+	{
+		_overflow.push_back(entry_p);
+		return;
+	}
+	_slots[tick_l % slots_l].push_back(entry_p);
+}
+
+void TimerWheel::migrate_overflow()
+{
+	int64_t slots_l = int64_t(_slots.size());
+	size_t kept_l = 0;
+	for(size_t i = 0 ; i < _overflow.size() ; ++ i)
+	{
+		TimerEntry entry_l = _overflow[i];
+		if(tick(entry_l.time) - _current_tick < slots_l)
+		{
+			_slots[std::max(tick(entry_l.time), _current_tick) % slots_l].push_back(entry_l);
+		}
+		else
+		{
+			_overflow[kept_l++] = entry_l;
+		}
+	}
+	_overflow.resize(kept_l);
+}
+
+} // godot
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace godot {
+
+/// @brief entry of the timer wheel
+struct TimerEntry
+{
+	/// @brief time when the entry is due
+	double time = 0.;
+	/// @brief index of the entity
+	int idx = 0;
+	/// @brief stamp used to invalidate old entries
+	uint64_t stamp = 0;
+};
+
+/// @brief Timer wheel storing entries in buckets of fixed duration
+/// Entries beyond the horizon of the wheel (slots * resolution) are stored
+/// in an overflow list and moved into the wheel when getting close.
+/// Entries are never removed, they must be invalidated using the stamp
+class TimerWheel
+{
+public:
+	TimerWheel(double resolution_p = 1./256., size_t slots_p = 1024);
+
+	void schedule(double time_p, int idx_p, uint64_t stamp_p);
+
+	/// @brief fill due_p with all entries due at time_p (due_p is cleared first)
+	void pop_due(double time_p, std::vector<TimerEntry> &due_p);
+
+	void clear();
+
+	/// @brief number of entries stored (including invalidated ones)
+	size_t size() const { return _size; }
+
+private:
+	int64_t tick(double time_p) const;
+	void insert(TimerEntry const &entry_p);
+	void migrate_overflow();
+
+	double const _resolution;
+	std::vector<std::vector<TimerEntry> > _slots;
+	/// @brief entries beyond the horizon
+	std::vector<TimerEntry> _overflow;
+	/// @brief tick of the last pop
+	int64_t _current_tick = 0;
+	/// @brief next tick where the overflow must be checked
+	int64_t _next_overflow_tick = 0;
+	size_t _size = 0;
+};
+
+} // godot
@@ -0,0 +1,209 @@
+// Standalone check and benchmark of the interpolation of positions (no godot needed)
+// Interpolates 100k positions with :
+// - the previous layout : Vector2 arrays (AoS) interpolated per entity while iterating
+//   the instances, reaching the position through the position index handle
+// - lerp_floats_scalar over the x and y arrays (SoA)
+// - lerp_floats (SIMD) over the x and y arrays (SoA)
+// and checks that all give the same values
+//
+// g++ -std=c++17 -O2 -fno-tree-vectorize -mavx -I. bench/interpolate_positions.cpp PositionLerp.cpp -o interpolate_positions_bench
+// ./interpolate_positions_bench
+
+#include "PositionLerp.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using namespace godot;
+
+namespace
+{
+	size_t const POSITION_COUNT = 100000;
+	int const ITERATIONS = 1000;
+
+	struct Positions
+	{
+		std::vector<float> x;
+		std::vector<float> y;
+
+		explicit Positions(size_t size_p) : x(size_p), y(size_p) {}
+	};
+
+	using LerpFunc = void (*)(float const *, float const *, float, float *, size_t);
+
+	void interpolate(LerpFunc func_p, Positions const &from_p, Positions const &to_p, float t_p, Positions &out_p)
+	{
+		func_p(from_p.x.data(), to_p.x.data(), t_p, out_p.x.data(), out_p.x.size());
+		func_p(from_p.y.data(), to_p.y.data(), t_p, out_p.y.data(), out_p.y.size());
+	}
+
+	// previous layout (godot Vector2 with real_t = float)
+	struct Vec2
+	{
+		float x = 0.f;
+		float y = 0.f;
+	};
+
+	/// @brief the instance only holds the handle of its position index
+	/// (smart_list slots, as EntityInstance::pos_idx)
+	struct Instance
+	{
+		uint32_t pos_handle = 0;
+		/// @brief other fields of the instance between two handles
+		char payload[56];
+	};
+
+	struct PositionIndex
+	{
+		size_t idx = 0;
+	};
+
+	struct OldLayout
+	{
+		std::vector<Instance> instances;
+		std::vector<PositionIndex> pos_indexes;
+		std::vector<Vec2> old_pos;
+		std::vector<Vec2> new_pos;
+		/// @brief interpolated position per instance (consumed by the draw)
+		std::vector<Vec2> out;
+	};
+
+	/// @brief interpolation inlined in the per entity draw loop
+	__attribute__((noinline)) void interpolate_old(OldLayout &layout_p, float t_p)
+	{
+		for(size_t i = 0 ; i < layout_p.instances.size() ; ++ i)
+		{
+			size_t pos_idx_l = layout_p.pos_indexes[layout_p.instances[i].pos_handle].idx;
+			Vec2 const &old_l = layout_p.old_pos[pos_idx_l];
+			Vec2 const &new_l = layout_p.new_pos[pos_idx_l];
+			layout_p.out[i] = Vec2{old_l.x + (new_l.x - old_l.x) * t_p, old_l.y + (new_l.y - old_l.y) * t_p};
+		}
+	}
+
+	/// @return nanoseconds per position
+	double bench(LerpFunc func_p, Positions const &from_p, Positions const &to_p, Positions &out_p)
+	{
+		auto start_l = std::chrono::steady_clock::now();
+		for(int i = 0 ; i < ITERATIONS ; ++ i)
+		{
+			interpolate(func_p, from_p, to_p, float(i) / ITERATIONS, out_p);
+		}
+		auto end_l = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::nano>(end_l - start_l).count() / (double(ITERATIONS) * POSITION_COUNT);
+	}
+
+	/// @return nanoseconds per position
+	double bench_old(OldLayout &layout_p)
+	{
+		auto start_l = std::chrono::steady_clock::now();
+		for(int i = 0 ; i < ITERATIONS ; ++ i)
+		{
+			interpolate_old(layout_p, float(i) / ITERATIONS);
+		}
+		auto end_l = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::nano>(end_l - start_l).count() / (double(ITERATIONS) * POSITION_COUNT);
+	}
+
+	/// @brief previous layout over the same positions
+	/// shuffled_p : position indexes recycled in random order (after churn)
+	OldLayout make_old_layout(Positions const &from_p, Positions const &to_p, bool shuffled_p, std::mt19937 &gen_p)
+	{
+		OldLayout layout_l;
+		layout_l.instances.resize(POSITION_COUNT);
+		layout_l.pos_indexes.resize(POSITION_COUNT);
+		layout_l.old_pos.resize(POSITION_COUNT);
+		layout_l.new_pos.resize(POSITION_COUNT);
+		layout_l.out.resize(POSITION_COUNT);
+		std::vector<uint32_t> handles_l(POSITION_COUNT);
+		std::iota(handles_l.begin(), handles_l.end(), 0);
+		std::vector<uint32_t> slots_l = handles_l;
+		if(shuffled_p)
+		{
+			std::shuffle(handles_l.begin(), handles_l.end(), gen_p);
+			std::shuffle(slots_l.begin(), slots_l.end(), gen_p);
+		}
+		for(size_t i = 0 ; i < POSITION_COUNT ; ++ i)
+		{
+			layout_l.instances[i].pos_handle = handles_l[i];
+			layout_l.pos_indexes[handles_l[i]].idx = slots_l[i];
+			// instance i owns the position i of the SoA buffers
+			layout_l.old_pos[slots_l[i]] = Vec2{from_p.x[i], from_p.y[i]};
+			layout_l.new_pos[slots_l[i]] = Vec2{to_p.x[i], to_p.y[i]};
+		}
+		return layout_l;
+	}
+}
+
+int main()
+{
+	std::mt19937 gen_l(42);
+	std::uniform_real_distribution<float> dist_l(-10000.f, 10000.f);
+	std::uniform_real_distribution<float> step_l(-8.f, 8.f);
+
+	Positions from_l(POSITION_COUNT);
+	Positions to_l(POSITION_COUNT);
+	for(size_t i = 0 ; i < POSITION_COUNT ; ++ i)
+	{
+		from_l.x[i] = dist_l(gen_l);
+		from_l.y[i] = dist_l(gen_l);
+		to_l.x[i] = from_l.x[i] + step_l(gen_l);
+		to_l.y[i] = from_l.y[i] + step_l(gen_l);
+	}
+	OldLayout sequential_l = make_old_layout(from_l, to_l, false, gen_l);
+	OldLayout shuffled_l = make_old_layout(from_l, to_l, true, gen_l);
+
+	// check (odd sizes exercise the remainder of the SIMD loop)
+	Positions simd_l(POSITION_COUNT);
+	Positions scalar_l(POSITION_COUNT);
+	float max_diff_l = 0.f;
+	float const ts_l[] = {0.f, 0.25f, 0.5f, 0.999f, 1.f, 1.5f};
+	for(float t_l : ts_l)
+	{
+		for(size_t size_l : {POSITION_COUNT, POSITION_COUNT - 1, POSITION_COUNT - 7})
+		{
+			lerp_floats(from_l.x.data(), to_l.x.data(), t_l, simd_l.x.data(), size_l);
+			lerp_floats_scalar(from_l.x.data(), to_l.x.data(), t_l, scalar_l.x.data(), size_l);
+			lerp_floats(from_l.y.data(), to_l.y.data(), t_l, simd_l.y.data(), size_l);
+			lerp_floats_scalar(from_l.y.data(), to_l.y.data(), t_l, scalar_l.y.data(), size_l);
+			for(size_t i = 0 ; i < size_l ; ++ i)
+			{
+				max_diff_l = std::max(max_diff_l, std::abs(simd_l.x[i] - scalar_l.x[i]));
+				max_diff_l = std::max(max_diff_l, std::abs(simd_l.y[i] - scalar_l.y[i]));
+			}
+		}
+		// previous layout over all the positions
+		interpolate_old(shuffled_l, t_l);
+		for(size_t i = 0 ; i < POSITION_COUNT ; ++ i)
+		{
+			max_diff_l = std::max(max_diff_l, std::abs(shuffled_l.out[i].x - simd_l.x[i]));
+			max_diff_l = std::max(max_diff_l, std::abs(shuffled_l.out[i].y - simd_l.y[i]));
+		}
+	}
+	// NEON may contract the multiply add : allow one float step at the magnitude of the positions
+	float const tolerance_l = 0.002f;
+	std::printf("max difference between the interpolations : %g\n", double(max_diff_l));
+	if(max_diff_l > tolerance_l)
+	{
+		std::printf("FAILED : interpolations differ\n");
+		return 1;
+	}
+
+	Positions out_l(POSITION_COUNT);
+	double old_shuffled_ns_l = bench_old(shuffled_l);
+	double old_sequential_ns_l = bench_old(sequential_l);
+	double scalar_ns_l = bench(&lerp_floats_scalar, from_l, to_l, out_l);
+	double simd_ns_l = bench(&lerp_floats, from_l, to_l, out_l);
+	std::printf("%zu positions (ns/position)\n", POSITION_COUNT);
+	std::printf("  previous AoS per entity, recycled indexes : %.3f\n", old_shuffled_ns_l);
+	std::printf("  previous AoS per entity, sequential       : %.3f\n", old_sequential_ns_l);
+	std::printf("  SoA scalar                                : %.3f\n", scalar_ns_l);
+	std::printf("  SoA simd                                  : %.3f (x%.2f vs recycled, x%.2f vs sequential)\n",
+		simd_ns_l, old_shuffled_ns_l / simd_ns_l, old_sequential_ns_l / simd_ns_l);
+	return 0;
+}
@@ -0,0 +1,218 @@
+// Standalone check and benchmark of the scan of the picking texture (no godot needed)
+// Box selects the whole of a 1920x1080 RGBA8 picking buffer (first query of a read back : the
+// pyramid is not built) with :
+// - the previous scan : background skipped several pixels at a time, then every pixel decoded
+//   and tested against the bitset one at a time
+// - collect_runs_scalar then the bitset on the first pixel of every run
+// - collect_runs (SIMD) then the bitset on the first pixel of every run
+// and checks that all give the same indexes
+//
+// g++ -std=c++17 -O2 -fno-tree-vectorize -I. bench/picking_scan.cpp PickingScan.cpp -o picking_scan_bench
+// ./picking_scan_bench
+
+#include "PickingScan.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+	#include <emmintrin.h>
+#endif
+
+using namespace godot;
+
+namespace
+{
+	int const WIDTH = 1920;
+	int const HEIGHT = 1080;
+	int const SPRITE_COUNT = 20000;
+	int const SPRITE_SIZE = 32;
+	int const ITERATIONS = 100;
+
+	/// @brief unique indexes (dedup as PickingBuffer::add_index)
+	struct Selection
+	{
+		std::vector<uint64_t> seen;
+		std::vector<int32_t> indexes;
+
+		explicit Selection(int max_index_p) : seen((size_t(max_index_p) + 63) / 64, 0) {}
+
+		void add(uint32_t idx_p)
+		{
+			uint64_t bit_l = uint64_t(1) << (idx_p & 63);
+			if(!(seen[idx_p >> 6] & bit_l))
+			{
+				seen[idx_p >> 6] |= bit_l;
+				indexes.push_back(int32_t(idx_p));
+			}
+		}
+
+		void clear()
+		{
+			for(int32_t idx_l : indexes)
+			{
+				seen[idx_l >> 6] = 0;
+			}
+			indexes.clear();
+		}
+	};
+
+	// previous scan of PickingBuffer (SSE2 background skip)
+	int skip_background(uint32_t const *row_p, int count_p)
+	{
+		int i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+		__m128i mask_l = _mm_set1_epi32(int(PICKING_RGB_MASK));
+		__m128i background_l = _mm_set1_epi32(int(PICKING_BACKGROUND));
+		for( ; i + 4 <= count_p ; i += 4)
+		{
+			__m128i pixels_l = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<__m128i const *>(row_p + i)), mask_l);
+			if(_mm_movemask_epi8(_mm_cmpeq_epi32(pixels_l, background_l)) != 0xFFFF)
+			{
+				break;
+			}
+		}
+#endif
+		for( ; i < count_p ; ++ i)
+		{
+			if((row_p[i] & PICKING_RGB_MASK) != PICKING_BACKGROUND)
+			{
+				break;
+			}
+		}
+		return i;
+	}
+
+	void select_previous(std::vector<uint8_t> const &buffer_p, std::vector<uint32_t> &row_p, Selection &selection_p)
+	{
+		for(int y = 0 ; y < HEIGHT ; ++ y)
+		{
+			std::memcpy(row_p.data(), buffer_p.data() + size_t(y) * WIDTH * 4, size_t(WIDTH) * 4);
+			int x = 0;
+			while(x < WIDTH)
+			{
+				x += skip_background(row_p.data() + x, WIDTH - x);
+				if(x >= WIDTH)
+				{
+					break;
+				}
+				selection_p.add(row_p[x] & PICKING_RGB_MASK);
+				++x;
+			}
+		}
+	}
+
+	using CollectFunc = size_t (*)(uint8_t const *, size_t, uint32_t *);
+
+	void select_runs(CollectFunc func_p, std::vector<uint8_t> const &buffer_p, std::vector<uint32_t> &runs_p, Selection &selection_p)
+	{
+		for(int y = 0 ; y < HEIGHT ; ++ y)
+		{
+			size_t runs_l = func_p(buffer_p.data() + size_t(y) * WIDTH * 4, WIDTH, runs_p.data());
+			for(size_t i = 0 ; i < runs_l ; ++ i)
+			{
+				selection_p.add(runs_p[i]);
+			}
+		}
+	}
+
+	/// @return milliseconds per box select
+	template<typename Select>
+	double bench(Select const &select_p, Selection &selection_p)
+	{
+		auto start_l = std::chrono::steady_clock::now();
+		for(int i = 0 ; i < ITERATIONS ; ++ i)
+		{
+			selection_p.clear();
+			select_p();
+		}
+		auto end_l = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::milli>(end_l - start_l).count() / ITERATIONS;
+	}
+
+	std::vector<int32_t> sorted(std::vector<int32_t> indexes_p)
+	{
+		std::sort(indexes_p.begin(), indexes_p.end());
+		return indexes_p;
+	}
+}
+
+int main()
+{
+	// background then sprites drawn over each other (later indexes in front)
+	std::vector<uint8_t> buffer_l(size_t(WIDTH) * HEIGHT * 4, 255);
+	std::mt19937 gen_l(42);
+	std::uniform_int_distribution<int> x_l(-SPRITE_SIZE, WIDTH);
+	std::uniform_int_distribution<int> y_l(-SPRITE_SIZE, HEIGHT);
+	std::uniform_int_distribution<int> size_l(SPRITE_SIZE / 2, SPRITE_SIZE);
+	for(int idx = 0 ; idx < SPRITE_COUNT ; ++ idx)
+	{
+		int min_x_l = x_l(gen_l);
+		int min_y_l = y_l(gen_l);
+		int w_l = size_l(gen_l);
+		int h_l = size_l(gen_l);
+		for(int y = std::max(min_y_l, 0) ; y < std::min(min_y_l + h_l, HEIGHT) ; ++ y)
+		{
+			for(int x = std::max(min_x_l, 0) ; x < std::min(min_x_l + w_l, WIDTH) ; ++ x)
+			{
+				// rounded corners leave background inside the sprite rect
+				if((y == min_y_l || y == min_y_l + h_l - 1) && (x == min_x_l || x == min_x_l + w_l - 1))
+				{
+					continue;
+				}
+				uint8_t *pixel_l = buffer_l.data() + (size_t(y) * WIDTH + x) * 4;
+				pixel_l[0] = uint8_t(idx);
+				pixel_l[1] = uint8_t(idx >> 8);
+				pixel_l[2] = uint8_t(idx >> 16);
+				pixel_l[3] = 255;
+			}
+		}
+	}
+
+	std::vector<uint32_t> row_l(WIDTH);
+	Selection previous_l(SPRITE_COUNT);
+	Selection scalar_l(SPRITE_COUNT);
+	Selection simd_l(SPRITE_COUNT);
+
+	// check (odd counts and offsets exercise the remainder and the unaligned loads of the SIMD loop)
+	for(size_t offset_l : {0, 1, 3})
+	{
+		for(size_t count_l : {size_t(WIDTH) - offset_l, size_t(WIDTH) - offset_l - 5, size_t(1), size_t(4), size_t(5)})
+		{
+			for(int y = 0 ; y < HEIGHT ; y += 7)
+			{
+				uint8_t const *pixels_l = buffer_l.data() + (size_t(y) * WIDTH + offset_l) * 4;
+				size_t scalar_runs_l = collect_runs_scalar(pixels_l, count_l, row_l.data());
+				std::vector<uint32_t> expected_l(row_l.begin(), row_l.begin() + scalar_runs_l);
+				size_t simd_runs_l = collect_runs(pixels_l, count_l, row_l.data());
+				if(simd_runs_l != scalar_runs_l || !std::equal(expected_l.begin(), expected_l.end(), row_l.begin()))
+				{
+					std::printf("FAILED : runs differ (row %d, offset %zu, count %zu)\n", y, offset_l, count_l);
+					return 1;
+				}
+			}
+		}
+	}
+	select_previous(buffer_l, row_l, previous_l);
+	select_runs(&collect_runs_scalar, buffer_l, row_l, scalar_l);
+	select_runs(&collect_runs, buffer_l, row_l, simd_l);
+	if(sorted(previous_l.indexes) != sorted(scalar_l.indexes) || sorted(previous_l.indexes) != sorted(simd_l.indexes))
+	{
+		std::printf("FAILED : selections differ\n");
+		return 1;
+	}
+	std::printf("%zu indexes selected\n", previous_l.indexes.size());
+
+	double previous_ms_l = bench([&]() { select_previous(buffer_l, row_l, previous_l); }, previous_l);
+	double scalar_ms_l = bench([&]() { select_runs(&collect_runs_scalar, buffer_l, row_l, scalar_l); }, scalar_l);
+	double simd_ms_l = bench([&]() { select_runs(&collect_runs, buffer_l, row_l, simd_l); }, simd_l);
+	std::printf("%dx%d box select (ms)\n", WIDTH, HEIGHT);
+	std::printf("  previous (background skip only) : %.3f\n", previous_ms_l);
+	std::printf("  runs scalar                     : %.3f\n", scalar_ms_l);
+	std::printf("  runs simd                       : %.3f (x%.2f vs previous)\n", simd_ms_l, previous_ms_l / simd_ms_l);
+	return 0;
+}